@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chip/chip.h>
+
+/*
+ * libFuzzer target for the headless core.
+ *
+ * Input: ROM length (2 bytes, little-endian), the ROM, then the key schedule:
+ * one key bitmask (2 bytes, little-endian) per frame. Every input runs at
+ * least FUZZ_MIN_FRAMES frames, keys up once the schedule is over.
+ */
+#define FUZZ_MIN_FRAMES 0x10
+#define FUZZ_MAX_FRAMES 0x100
+
+// instruction kinds, see fuzz_kind
+#define FUZZ_KINDS 0x40
+
+// coverage read by libFuzzer next to its own: PCs reached and kind-to-kind edges
+__attribute__((section("__libfuzzer_extra_counters"))) static uint8 fuzz_counters[0x800 + FUZZ_KINDS * FUZZ_KINDS];
+
+static chip_state fuzz_image;
+static chip_state fuzz_machine;
+
+/**
+ * @brief Number an opcode by the instruction it runs, below FUZZ_KINDS
+ */
+static uint8 fuzz_kind(uint16 opcode)
+{
+    static const uint8 fx[] = {0x07, 0x0A, 0x15, 0x18, 0x1E, 0x29, 0x33, 0x55, 0x65};
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        return opcode == 0x00E0 ? 0x00 : opcode == 0x00EE ? 0x10 : 0x11;
+    case 0x8:
+        return 0x20 + (opcode & 0xF);
+    case 0xE:
+        return (opcode & 0xFF) == 0x9E ? 0x30 : 0x31;
+    case 0xF:
+        for (uint8 i = 0; i < sizeof(fx); i++)
+            if ((opcode & 0xFF) == fx[i])
+                return 0x32 + i;
+        return 0x3B;
+    default:
+        return opcode >> 12;
+    }
+}
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    chip = &fuzz_image;
+    util_chip_init();
+
+    return 0;
+}
+
+int LLVMFuzzerTestOneInput(const uint8 *data, size_t size)
+{
+    if (size < 2)
+        return 0;
+
+    uint32 length = data[0] | data[1] << 8;
+    data += 2, size -= 2;
+
+    if (length > size)
+        length = size;
+
+    // persistent mode: every input starts from the same blank machine, one copy away
+    chip = &fuzz_machine;
+    util_chip_restore(&fuzz_image);
+    util_chip_load_ROM_bytes(data, length);
+    chip->seed = util_chip_hash(data, length);
+
+    const uint8 *schedule = data + length;
+    uint32 frames = (size - length) / 2;
+
+    if (frames > FUZZ_MAX_FRAMES)
+        frames = FUZZ_MAX_FRAMES;
+
+    uint8 last = 0;
+
+    for (uint32 f = 0; f < frames || f < FUZZ_MIN_FRAMES; f++)
+    {
+        uint16 keys = f < frames ? schedule[2 * f] | schedule[2 * f + 1] << 8 : 0;
+
+        for (uint8 k = 0; k < 0x10; k++)
+            chip->key_state[k] = (keys >> k) & 1;
+
+        // util_chip_frame, with a coverage probe before every instruction
+        if (chip->delay_timer > 0)
+            chip->delay_timer--;
+        if (chip->sound_timer > 0)
+            chip->sound_timer--;
+
+        for (uint8 i = 0; i < CHIP_FRAME_CYCLES; i++)
+        {
+            uint16 opcode = (chip->memory[chip->PC & 0xFFF] << 8) + chip->memory[(chip->PC & 0xFFF) + 1];
+            uint8 kind = fuzz_kind(opcode);
+
+            fuzz_counters[(chip->PC & 0xFFF) >> 1]++;
+            fuzz_counters[0x800 + last * FUZZ_KINDS + kind]++;
+            last = kind;
+
+            util_chip_cycle();
+
+            // the machine must stay inside its own state whatever the ROM does
+            if (chip->SP > 0xF || chip->I > 0xFFF)
+                abort();
+
+            // and reads past the end of memory must see its start
+            if (memcmp(chip->memory + CHIP_MEMORY_SIZE, chip->memory, CHIP_MEMORY_GUARD) != 0)
+                abort();
+        }
+
+        memcpy(chip->key_prev, chip->key_state, sizeof(chip->key_prev));
+    }
+
+    return 0;
+}
+
+#ifdef CHIP_FUZZ_MAIN
+// replay inputs without libFuzzer, e.g. crashes found on another machine
+int main(int argc, char **argv)
+{
+    LLVMFuzzerInitialize(&argc, &argv);
+
+    for (int i = 1; i < argc; i++)
+    {
+        FILE *file = fopen(argv[i], "rb");
+
+        if (file == 0)
+        {
+            perror("Failed to open input.\n");
+            return 1;
+        }
+
+        static uint8 input[0x10000];
+        size_t size = fread(input, 1, sizeof(input), file);
+        fclose(file);
+
+        LLVMFuzzerTestOneInput(input, size);
+    }
+
+    return 0;
+}
+#endif
@@ -5,18 +5,31 @@
 #include "chip_specifications.h"
 #include "chip_instructions.h"
 
+// chip instructions executed every frame
+#define CHIP_FRAME_CYCLES 10
+
 // chip display scale
-uint8 scaling;
+extern uint8 scaling;
 
 // chip frame rate
-uint8 frame_rate;
+extern uint8 frame_rate;
 
-// chip frame counter
-uint64 frame;
+// chip instruction counter
+extern uint64 frame;
 
 void util_chip_init();
+void util_chip_snapshot(chip_state *);
+void util_chip_restore(const chip_state *);
+void util_chip_mirror(chip_state *, uint16, uint16);
 uint8 util_chip_load_ROM(const char *);
+uint8 util_chip_read_ROM(const char *, uint8 *, uint32 *);
+void util_chip_load_ROM_bytes(const uint8 *, uint32);
 void util_chip_execute(uint16);
+void util_chip_cycle();
+void util_chip_frame();
+uint8 util_chip_suspended();
+uint32 util_chip_random(uint64, uint64);
+uint64 util_chip_hash(const void *, uint32);
 
 uint8 alpha(uint32);
 uint8 red(uint32);
@@ -0,0 +1,52 @@
+#ifndef CHIP_ANALYSIS_H
+#define CHIP_ANALYSIS_H
+
+#include <stddef.h>
+
+#include "chip_datatype.h"
+
+// what following the control flow found at an address
+#define CHIP_ADDR_CODE 0x01
+#define CHIP_ADDR_OPERAND 0x02
+#define CHIP_ADDR_DATA 0x04
+#define CHIP_ADDR_LEADER 0x08
+#define CHIP_ADDR_SUBROUTINE 0x10
+#define CHIP_ADDR_INDIRECT 0x20
+
+// a CALL instruction and the subroutine it enters
+typedef struct chip_call
+{
+    uint16 from;
+    uint16 to;
+} chip_call;
+
+// a ROM and what is statically known about its code
+typedef struct chip_analysis
+{
+    uint8 bytes[0x1000 - 0x200];
+    uint32 size;
+
+    // CHIP_ADDR_ flags of every address
+    uint8 addr[0x1000];
+
+    // the call graph, in address order of the calls: a CALL may start at any address, odd ones too
+    chip_call call[0x1000 - 0x200];
+    uint32 calls;
+
+    uint32 blocks;
+    uint32 instructions;
+    uint32 subroutines;
+    uint32 indirect;
+
+    // addresses read both as code and as something else: operand bytes of another instruction or sprite data
+    uint32 overlaps;
+} chip_analysis;
+
+uint8 util_analysis_ends(uint16);
+uint16 util_analysis_opcode(const chip_analysis *, uint16);
+uint16 util_analysis_extent(const chip_analysis *, uint16);
+uint8 util_analysis_overlap(const chip_analysis *, uint16);
+void util_analysis_walk(chip_analysis *, const uint8 *, uint32);
+void util_analysis_mnemonic(uint16, char *, size_t);
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef CHIP_AOT_H
+#define CHIP_AOT_H
+
+#include "chip_datatype.h"
+
+// headers translations are compiled against, unless CHIP_AOT_INCLUDE is set in the environment
+#ifndef CHIP_AOT_INCLUDE
+#define CHIP_AOT_INCLUDE "include"
+#endif
+
+// compiler command for translations, unless CHIP_AOT_CC is set in the environment
+#define CHIP_AOT_CC "cc -O2 -shared -fPIC -ftls-model=initial-exec"
+
+// a translated ROM, compiled and loaded: the same as util_chip_load_ROM_bytes, the fetch-execute loop and util_chip_frame
+typedef struct chip_aot
+{
+    void *handle;
+    void (*load)();
+    void (*run)(uint32);
+    void (*frame)();
+} chip_aot;
+
+chip_aot *util_aot_open(const char *, const uint8 *, uint32);
+void util_aot_close(chip_aot *);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef CHIP_CPU_H
+#define CHIP_CPU_H
+
+#include "chip_datatype.h"
+
+// instruction sets vector kernels are built for, each a superset of the one before
+#define CHIP_CPU_SSE2 0
+#define CHIP_CPU_AVX2 1
+#define CHIP_CPU_AVX512 2
+#define CHIP_CPU_LEVELS 3
+
+uint8 util_cpu_supported(uint8);
+uint8 util_cpu_level();
+uint8 util_cpu_force(const char *);
+const char *util_cpu_name(uint8);
+
+#endif
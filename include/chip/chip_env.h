@@ -0,0 +1,70 @@
+#ifndef CHIP_ENV_H
+#define CHIP_ENV_H
+
+#include "chip_datatype.h"
+#include "chip_specifications.h"
+#include "chip_pool.h"
+
+// reward hook: called after every step with the env's machine
+typedef float (*chip_reward)(const chip_state *, void *);
+
+// done hook: 1 when the episode is over
+typedef uint8 (*chip_done)(const chip_state *, void *);
+
+// outcome of a step; observation points into the machine's display (0x20 rows of 0x40 pixels)
+typedef struct chip_step
+{
+    const uint8 *observation;
+    float reward;
+    uint8 done;
+} chip_step;
+
+typedef struct chip_env
+{
+    // running machine
+    chip_state machine;
+
+    // machine right after the ROM was loaded
+    chip_state image;
+
+    chip_reward reward;
+    chip_done done;
+    void *user;
+
+    // frames since the last reset
+    uint64 frames;
+} chip_env;
+
+// environments stepped together on a pool
+typedef struct chip_vec_env
+{
+    chip_env *env;
+    uint32 count;
+    chip_pool *pool;
+
+    // current step
+    const uint16 *action;
+    uint32 frames;
+    chip_step *result;
+
+    // whether each environment runs this step, the others are suspended
+    uint8 *ready;
+    uint32 ready_count;
+} chip_vec_env;
+
+chip_env *util_env_create(const char *);
+void util_env_hooks(chip_env *, chip_reward, chip_done, void *);
+void util_env_seed(chip_env *, uint64);
+const uint8 *util_env_reset(chip_env *);
+uint8 util_env_suspended(const chip_env *, uint16);
+chip_step util_env_step(chip_env *, uint16, uint32);
+void util_env_destroy(chip_env *);
+
+chip_vec_env *util_vec_env_create(const char *, uint32, uint32, uint8);
+void util_vec_env_hooks(chip_vec_env *, chip_reward, chip_done, void *);
+void util_vec_env_seed(chip_vec_env *, uint64);
+void util_vec_env_reset(chip_vec_env *);
+const chip_step *util_vec_env_step(chip_vec_env *, const uint16 *, uint32);
+void util_vec_env_destroy(chip_vec_env *);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef CHIP_FORK_H
+#define CHIP_FORK_H
+
+#include "chip_datatype.h"
+#include "chip_specifications.h"
+
+// shared 256-byte pages: 16 of memory followed by 8 of display
+#define CHIP_FORK_PAGE 0x100
+#define CHIP_FORK_PAGES 0x18
+
+// immutable once shared: a write makes a new page
+typedef struct chip_page
+{
+    uint32 refs;
+    uint64 id;
+    uint64 hash;
+    uint8 data[CHIP_FORK_PAGE];
+} chip_page;
+
+// page table, shared by forks until one of them writes
+typedef struct chip_pages
+{
+    uint32 refs;
+    chip_page *page[CHIP_FORK_PAGES];
+} chip_pages;
+
+// a machine saved for tree search: registers plus a reference to its pages
+typedef struct chip_fork
+{
+    chip_pages *pages;
+
+    uint16 stack[0x10];
+    uint8 V[0x10];
+    uint16 PC;
+    uint8 SP;
+    uint16 I;
+    uint8 delay_timer;
+    uint8 sound_timer;
+    uint8 key_state[0x10];
+    uint8 key_prev[0x10];
+    uint8 waiting;
+    uint8 quirks;
+    uint64 seed;
+    uint64 draws;
+    uint64 cycles;
+} chip_fork;
+
+// machine that runs forks, remembering which pages it already holds
+typedef struct chip_fork_host
+{
+    chip_state machine;
+    uint64 held[CHIP_FORK_PAGES];
+} chip_fork_host;
+
+chip_fork *util_fork_capture(const chip_state *);
+chip_fork *util_fork(const chip_fork *);
+void util_fork_enter(chip_fork_host *, const chip_fork *);
+chip_fork *util_fork_commit(chip_fork_host *, const chip_fork *);
+void util_fork_release(chip_fork *);
+uint64 util_fork_hash(const chip_fork *);
+
+#endif
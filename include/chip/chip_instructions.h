@@ -40,6 +40,7 @@ void JP2(uint16);
 void RND(uint8, uint8);
 
 void DRW(uint8, uint8, uint8);
+void DRW_NOFLAG(uint8, uint8, uint8);
 
 void SKP(uint8);
 void SKNP(uint8);
@@ -0,0 +1,68 @@
+#ifndef CHIP_LOCKSTEP_H
+#define CHIP_LOCKSTEP_H
+
+#include "chip_datatype.h"
+#include "chip_specifications.h"
+
+// lanes handled by one vector instruction
+#define CHIP_LOCKSTEP_WIDTH 32
+
+// groups of lanes sharing a PC run together per instruction; lanes past them run one by one
+#define CHIP_LOCKSTEP_GROUPS 8
+
+// many copies of one ROM executed in lockstep, registers stored lane by lane
+typedef struct chip_lockstep
+{
+    // number of machines
+    uint32 lanes;
+
+    // lanes rounded up to CHIP_LOCKSTEP_WIDTH
+    uint32 stride;
+
+    // chip registers: V[reg * stride + lane]
+    uint8 *V;
+
+    // chip program counters
+    uint16 *PC;
+
+    // chip address registers
+    uint16 *I;
+
+    // chip timers
+    uint8 *delay_timer;
+    uint8 *sound_timer;
+
+    // lanes executing the current instruction together
+    uint8 *mask;
+
+    // lanes that already ran the current instruction, 0xFF like mask
+    uint8 *ran;
+
+    // per lane memory, stack, display and keyboard; registers are stale until util_lockstep_machine
+    chip_state *machine;
+
+    // executed instructions, the same for every lane
+    uint64 cycles;
+
+    // instructions run lane by lane on the interpreter, over all lanes; the others ran vectorized
+    uint64 scalar;
+
+    // quirks of the image, the same for every lane
+    uint8 quirks;
+
+    // CHIP_CPU_ level the vector code runs at, util_cpu_level when created
+    uint8 kernel;
+
+    // addresses written by any lane since the start: [written_lo, written_hi]
+    uint16 written_lo;
+    uint16 written_hi;
+} chip_lockstep;
+
+chip_lockstep *util_lockstep_create(const chip_state *, uint32);
+void util_lockstep_cycle(chip_lockstep *);
+void util_lockstep_frame(chip_lockstep *);
+chip_state *util_lockstep_machine(chip_lockstep *, uint32);
+void util_lockstep_store(chip_lockstep *, uint32);
+void util_lockstep_destroy(chip_lockstep *);
+
+#endif
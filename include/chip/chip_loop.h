@@ -0,0 +1,23 @@
+#ifndef CHIP_LOOP_H
+#define CHIP_LOOP_H
+
+#include "chip_datatype.h"
+#include "chip_specifications.h"
+
+// Brent's cycle detection over the states a machine goes through frame after frame
+typedef struct chip_loop
+{
+    // state saved at the last power of two
+    chip_state saved;
+
+    // frames the detector may wait before saving again
+    uint64 power;
+
+    // frames since the state was saved
+    uint64 length;
+} chip_loop;
+
+void util_loop_init(chip_loop *, const chip_state *);
+uint64 util_loop_check(chip_loop *, const chip_state *);
+
+#endif
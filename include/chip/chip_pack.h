@@ -0,0 +1,51 @@
+#ifndef CHIP_PACK_H
+#define CHIP_PACK_H
+
+#include "chip_datatype.h"
+
+/*
+ * ROM archive (.c8pk), every number little-endian:
+ *
+ *   header   "C8PK", version (4 bytes), count (4 bytes), 4 reserved,
+ *            index, names and data offsets (8 bytes each)
+ *   index    count entries sorted by hash: hash (8), data offset (4),
+ *            size (4), name offset (4), name length (4)
+ *   by name  count entry numbers (4 bytes each) sorted by name
+ *   names    NUL terminated names
+ *   data     ROM bytes, stored once per distinct ROM
+ */
+#define CHIP_PACK_MAGIC "C8PK"
+#define CHIP_PACK_VERSION 1
+#define CHIP_PACK_HEADER 40
+#define CHIP_PACK_ENTRY 24
+
+// a ROM inside an archive: name and data point into the mapped file
+typedef struct chip_rom
+{
+    const char *name;
+    const uint8 *data;
+    uint32 size;
+    uint64 hash;
+} chip_rom;
+
+typedef struct chip_pack
+{
+    const uint8 *base;
+    uint64 size;
+    uint32 count;
+    const uint8 *index;
+    const uint8 *by_name;
+    const char *names;
+    const uint8 *data;
+} chip_pack;
+
+chip_pack *util_pack_open(const char *);
+void util_pack_entry(const chip_pack *, uint32, chip_rom *);
+uint8 util_pack_find(const chip_pack *, uint64, chip_rom *);
+uint8 util_pack_find_name(const chip_pack *, const char *, chip_rom *);
+void util_pack_close(chip_pack *);
+
+uint64 util_pack_read(const uint8 *, uint8);
+void util_pack_write(uint8 *, uint64, uint8);
+
+#endif
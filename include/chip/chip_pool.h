@@ -0,0 +1,19 @@
+#ifndef CHIP_POOL_H
+#define CHIP_POOL_H
+
+#include "chip_datatype.h"
+
+// task body: called once for every index of a job
+typedef void (*chip_task)(uint32 index, void *arg);
+
+typedef struct chip_pool chip_pool;
+
+chip_pool *util_pool_create(uint32, uint8);
+void util_pool_run(chip_pool *, uint32, chip_task, void *);
+void util_pool_run_fixed(chip_pool *, uint32, chip_task, void *);
+uint32 util_pool_threads(const chip_pool *);
+uint32 util_pool_node(const chip_pool *, uint32);
+uint32 util_pool_worker();
+void util_pool_destroy(chip_pool *);
+
+#endif
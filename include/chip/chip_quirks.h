@@ -0,0 +1,39 @@
+#ifndef CHIP_QUIRKS_H
+#define CHIP_QUIRKS_H
+
+#include "chip_datatype.h"
+#include "chip_pool.h"
+
+// frames every quirk profile runs for during detection, unless asked otherwise
+#define CHIP_QUIRKS_FRAMES 2000
+
+// a named set of quirks
+typedef struct chip_quirk_profile
+{
+    const char *name;
+    uint8 quirks;
+} chip_quirk_profile;
+
+extern const chip_quirk_profile chip_quirk_profiles[];
+
+// how a ROM behaved under one set of quirks: lower penalty, then more screens, is saner
+typedef struct chip_quirk_trial
+{
+    uint8 quirks;
+    uint64 penalty;
+    uint32 screens;
+} chip_quirk_trial;
+
+// decisions already taken, by ROM hash; safe to share between threads
+typedef struct chip_quirk_cache chip_quirk_cache;
+
+uint8 util_quirks_detect(const uint8 *, uint32, uint32, chip_pool *, chip_quirk_trial *);
+uint8 util_quirks_parse(const char *, uint8 *);
+const char *util_quirks_name(uint8);
+
+chip_quirk_cache *util_quirk_cache_open(const char *);
+uint8 util_quirk_cache_get(chip_quirk_cache *, uint64, uint8 *);
+void util_quirk_cache_put(chip_quirk_cache *, uint64, uint8);
+uint8 util_quirk_cache_close(chip_quirk_cache *);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef CHIP_RING_H
+#define CHIP_RING_H
+
+#include "chip_datatype.h"
+
+// single producer, single consumer ring of fixed-size records in shared memory
+typedef struct chip_ring
+{
+    // next record to pop and next record to push, on their own cache lines
+    uint64 head __attribute__((aligned(64)));
+    uint64 tail __attribute__((aligned(64)));
+
+    uint32 slots __attribute__((aligned(64)));
+    uint32 size;
+    uint8 data[];
+} chip_ring;
+
+chip_ring *util_ring_create(uint32, uint32);
+uint8 util_ring_push(chip_ring *, const void *);
+uint8 util_ring_pop(chip_ring *, void *);
+void util_ring_reset(chip_ring *);
+void util_ring_destroy(chip_ring *);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef CHIP_SEEN_H
+#define CHIP_SEEN_H
+
+#include "chip_datatype.h"
+
+// concurrent set of state hashes, open addressing with linear probing
+typedef struct chip_seen
+{
+    uint64 *slot;
+    uint64 mask;
+    uint64 count;
+
+    // set once the table refused an insert for being too full
+    uint8 full;
+} chip_seen;
+
+chip_seen *util_seen_create(uint64);
+uint8 util_seen_insert(chip_seen *, uint64);
+void util_seen_destroy(chip_seen *);
+
+#endif
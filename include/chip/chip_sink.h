@@ -0,0 +1,50 @@
+#ifndef CHIP_SINK_H
+#define CHIP_SINK_H
+
+#include "chip_datatype.h"
+
+/*
+ * Columnar result file (.c8rs), numbers in the writer's byte order:
+ *
+ *   header   "C8RS", byte order mark 0x0102030405060708 (8 bytes),
+ *            column count (8), then per column its type (1), name length (1) and name
+ *   blocks   "C8RB", row count (8), then per column its byte length (8) and data:
+ *            u8 columns one byte per row, u64 columns 8 bytes per row,
+ *            text columns the end offset of every row's text (8 bytes each) then the text
+ *
+ * Blocks are appended as workers fill them, so rows are not in submission order.
+ */
+#define CHIP_SINK_MAGIC "C8RS"
+#define CHIP_SINK_BLOCK "C8RB"
+#define CHIP_SINK_ORDER 0x0102030405060708ULL
+
+// rows a worker buffers before handing them to the writer
+#define CHIP_SINK_ROWS 0x4000
+
+enum chip_sink_type
+{
+    CHIP_SINK_U8,
+    CHIP_SINK_U64,
+    CHIP_SINK_TEXT,
+};
+
+typedef struct chip_sink_column
+{
+    const char *name;
+    uint8 type;
+} chip_sink_column;
+
+// a row's value: number for u8 and u64 columns, text for text columns
+typedef union chip_sink_value
+{
+    uint64 number;
+    const char *text;
+} chip_sink_value;
+
+typedef struct chip_sink chip_sink;
+
+chip_sink *util_sink_create(const char *, const chip_sink_column *, uint8, uint32);
+uint8 util_sink_append(chip_sink *, uint32, const chip_sink_value *);
+uint8 util_sink_close(chip_sink *);
+
+#endif
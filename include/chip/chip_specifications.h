@@ -3,40 +3,94 @@
 
 #include "chip_datatype.h"
 
-// chip memory
-uint8 memory[0x1000];
+// addressable memory
+#define CHIP_MEMORY_SIZE 0x1000
 
-// chip stack
-uint16 stack[0x10];
+// bytes past the end of memory mirroring its start, a cache line: reaching 15 bytes past
+// an address, as DRW, Fx55 and Fx65 do from I and fetches from PC, never needs to wrap
+#define CHIP_MEMORY_GUARD 0x40
 
-// chip registers
-uint8 V[0x10];
+// machines start on a cache line: stack, registers and timers share the line
+// right after memory, and machines side by side never share a line
+typedef struct chip_state
+{
+    // chip memory, then the guard: always a copy of the first CHIP_MEMORY_GUARD bytes
+    uint8 memory[CHIP_MEMORY_SIZE + CHIP_MEMORY_GUARD];
 
-// chip program counter
-uint16 PC;
+    // chip stack
+    uint16 stack[0x10];
 
-// chip stack pointer
-uint8 SP;
+    // chip registers
+    uint8 V[0x10];
 
-// chip address register
-uint16 I;
+    // chip program counter
+    uint16 PC;
 
-// chip delay timer
-uint8 delay_timer;
+    // chip stack pointer
+    uint8 SP;
 
-// chip sound timer
-uint8 sound_timer;
+    // chip address register, always below CHIP_MEMORY_SIZE
+    uint16 I;
 
-// chip display
-uint8 display[0x20][0x40];
+    // chip delay timer
+    uint8 delay_timer;
 
-// chip emulated keyboard: 1 for down, 0 for up
-uint8 key_state[0x10];
+    // chip sound timer
+    uint8 sound_timer;
 
-// chip keyobard previous state: 1 for down, 0 for up
-uint8 key_prev[0x10];
+    // chip display
+    uint8 display[0x20][0x40];
 
-// chip random value
-uint8 next;
+    // chip emulated keyboard: 1 for down, 0 for up
+    uint8 key_state[0x10];
 
-#endif
\ No newline at end of file
+    // chip keyobard previous state: 1 for down, 0 for up
+    uint8 key_prev[0x10];
+
+    // chip parked on Fx0A: it already ran it and found no key pressed
+    uint8 waiting;
+
+    // chip quirks: CHIP_QUIRK_* bits, 0 for the original COSMAC VIP behaviour
+    uint8 quirks;
+
+    // chip random seed
+    uint64 seed;
+
+    // chip random values drawn: the counter of the random generator
+    uint64 draws;
+
+    // chip executed instructions
+    uint64 cycles;
+
+    // chip 256-byte pages written since last cleared: bits 0-15 memory, bits 16-23 display
+    uint32 dirty;
+} __attribute__((aligned(64))) chip_state;
+
+// 8xy6 and 8xyE shift Vx in place instead of Vy into Vx
+#define CHIP_QUIRK_SHIFT 0x01
+
+// Fx55 and Fx65 leave I unchanged instead of moving it past the last register
+#define CHIP_QUIRK_MEMORY 0x02
+
+// Bxnn jumps to xnn + Vx instead of nnn + V0
+#define CHIP_QUIRK_JUMP 0x04
+
+// 8xy1, 8xy2 and 8xy3 leave VF alone instead of clearing it
+#define CHIP_QUIRK_LOGIC 0x08
+
+// sprites wrap around the edges of the display instead of being clipped
+#define CHIP_QUIRK_WRAP 0x10
+
+// every quirk bit
+#define CHIP_QUIRKS 0x1F
+
+// dirty bit of the memory page holding addr
+#define CHIP_DIRTY_MEMORY(addr) (1UL << (((addr) & 0xFFF) >> 8))
+
+// dirty bit of the display page holding row y (4 rows per page)
+#define CHIP_DIRTY_DISPLAY(y) (1UL << (0x10 + ((y) >> 2)))
+
+// running chip: every instruction operates on this machine, one per thread
+extern _Thread_local chip_state *chip;
+
+#endif
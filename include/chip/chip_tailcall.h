@@ -0,0 +1,20 @@
+#ifndef CHIP_TAILCALL_H
+#define CHIP_TAILCALL_H
+
+#include "chip_datatype.h"
+
+// handlers end in a guaranteed tail call where the compiler has one, else in an ordinary call optimizers turn into a jump
+#if defined(__has_attribute)
+#if __has_attribute(musttail)
+#define CHIP_MUSTTAIL __attribute__((musttail))
+#endif
+#endif
+
+#ifndef CHIP_MUSTTAIL
+#define CHIP_MUSTTAIL
+#endif
+
+void util_tailcall_run(uint32);
+void util_tailcall_frame();
+
+#endif
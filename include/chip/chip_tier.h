@@ -0,0 +1,80 @@
+#ifndef CHIP_TIER_H
+#define CHIP_TIER_H
+
+#include <pthread.h>
+
+#include "chip_aot.h"
+#include "chip_datatype.h"
+
+// entries into a block before it is predecoded
+#define CHIP_TIER_HOT 64
+
+// instructions run, over the whole ROM, before it is compiled to native code
+#define CHIP_TIER_NATIVE (1UL << 20)
+
+// longest predecoded block, in instructions
+#define CHIP_BLOCK_MAX 32
+
+// an instruction decoded once: what to run and its operands
+typedef struct chip_op
+{
+    uint8 kind;
+
+    // set on the first of a common pair of instructions: both run in one dispatch
+    uint8 fused;
+
+    uint8 x;
+    uint8 y;
+    uint8 n;
+    uint16 nnn;
+    uint16 opcode;
+} chip_op;
+
+// straight-line instructions from start, the last one possibly a jump
+typedef struct chip_block
+{
+    uint16 start;
+    uint8 length;
+
+    // the bytes the block was decoded from: it only runs while memory still holds them
+    uint8 bytes[2 * CHIP_BLOCK_MAX];
+    uint64 head;
+    uint64 mask;
+
+    chip_op op[CHIP_BLOCK_MAX];
+} chip_block;
+
+// the code of one ROM across its tiers, shared by every machine running it
+typedef struct chip_tier
+{
+    uint8 rom[0x1000 - 0x200];
+    uint32 size;
+
+    // tier 1: predecoded block starting at every address, 0 while interpreted
+    chip_block *block[0x1000];
+    uint32 hits[0x1000];
+    uint64 instructions;
+
+    // tier 2: the whole ROM compiled, 0 until then or without a cache directory
+    const char *translations;
+    chip_aot *aot;
+    void (*native)(uint32);
+    void (*native_frame)();
+
+    // blocks waiting for the compiler thread
+    pthread_t compiler;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    uint16 queue[0x1000];
+    uint32 queued;
+    uint8 pending[0x1000];
+    uint8 native_pending;
+    uint8 stop;
+} chip_tier;
+
+chip_tier *util_tier_create(const uint8 *, uint32, const char *);
+void util_tier_run(chip_tier *, uint32);
+void util_tier_frame(chip_tier *);
+void util_tier_destroy(chip_tier *);
+
+#endif
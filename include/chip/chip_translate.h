@@ -0,0 +1,23 @@
+#ifndef CHIP_TRANSLATE_H
+#define CHIP_TRANSLATE_H
+
+#include <stdio.h>
+
+#include "chip_analysis.h"
+#include "chip_datatype.h"
+
+// bumped whenever translations change, so cached ones are not reused
+#define CHIP_TRANSLATE_VERSION 5
+
+// a ROM's analysis and what translating it skipped
+typedef struct chip_translation
+{
+    chip_analysis rom;
+
+    // flags left uncomputed because VF is overwritten before being read
+    uint32 flags;
+} chip_translation;
+
+uint8 util_translate_write(FILE *, chip_translation *, const char *, const char *, uint8);
+
+#endif
@@ -1,44 +1,11 @@
 #include <chip/chip.h>
 
 #include <stdio.h>
-#include <time.h>
+#include <string.h>
 
-/**
- * @brief Initialize chip
- */
-void util_chip_init()
-{
-    // initialize memory
-    for (uint16 i = 0; i < 0x1000; i++)
-        memory[i] = 0;
-
-    // initialize stack
-    for (uint8 i = 0; i < 0x10; i++)
-        stack[i] = 0;
-
-    // initialize registers
-    for (uint8 i = 0; i < 0x10; i++)
-        V[i] = 0;
-
-    // initialize program counter
-    PC = 0x200;
-
-    // initialize stack pointer
-    SP = 0;
-
-    // initialize address register
-    I = 0;
-
-    // initialize timers
-    delay_timer = 0;
-    sound_timer = 0;
-
-    // initialize display (clear)
-    for (uint8 y = 0; y < 0x20; y++)
-        for (uint8 x = 0; x < 0x40; x++)
-            display[y][x] = 0;
-
-    uint8 default_font[0x50] = {
+// blank chip: zeroed machine with the default font loaded
+static const chip_state chip_blank = {
+    .memory = {
         0xF0, 0x90, 0x90, 0x90, 0xF0,
         0x20, 0x60, 0x20, 0x20, 0x70,
         0xF0, 0x10, 0xF0, 0x80, 0xF0,
@@ -54,18 +21,68 @@ void util_chip_init()
         0xF0, 0x80, 0x80, 0x90, 0xF0,
         0xE0, 0x90, 0x90, 0x90, 0xE0,
         0xF0, 0x80, 0xF0, 0x80, 0xF0,
-        0xF0, 0x80, 0xF0, 0x80, 0x80};
+        0xF0, 0x80, 0xF0, 0x80, 0x80},
+    .PC = 0x200};
 
-    // load font
-    for (uint8 i = 0; i < 0x50; i++)
-        memory[i] = default_font[i];
+// default machine
+static chip_state chip_main;
+
+_Thread_local chip_state *chip = &chip_main;
+
+uint8 scaling;
+uint8 frame_rate;
+uint64 frame;
+
+/**
+ * @brief Initialize chip
+ */
+void util_chip_init()
+{
+    util_chip_restore(&chip_blank);
+    util_chip_mirror(chip, 0, 0);
+}
+
+/**
+ * @brief Save the running chip into image
+ *
+ * @param image the machine image to write
+ */
+void util_chip_snapshot(chip_state *image)
+{
+    memcpy(image, chip, sizeof(chip_state));
+}
 
-    // initialize emulated keyboard
-    for (int i = 0; i < 16; i++)
-        key_state[i] = 0;
+/**
+ * @brief Replace the running chip with image
+ *
+ * Resetting a machine from the image taken right after util_chip_load_ROM
+ * is a single copy: no clearing loops and no file access.
+ *
+ * @param image the machine image to read
+ */
+void util_chip_restore(const chip_state *image)
+{
+    memcpy(chip, image, sizeof(chip_state));
+}
 
-    // initialize random value
-    next = time(0);
+/**
+ * @brief Bring the guard past the end of memory back in line with the start after machine wrote first to last
+ *
+ * Reads from I and PC run up to 15 bytes past their address without wrapping,
+ * so the CHIP_MEMORY_GUARD bytes past the end must always repeat the first
+ * ones: bytes written into the guard belong at the start of memory, bytes
+ * written at the start are copied into the guard.
+ *
+ * @param machine the machine written to
+ * @param first the first address written
+ * @param last the last address written, past the end of memory if the write wrapped
+ */
+void util_chip_mirror(chip_state *machine, uint16 first, uint16 last)
+{
+    if (last >= CHIP_MEMORY_SIZE)
+        memcpy(machine->memory, machine->memory + CHIP_MEMORY_SIZE, last - CHIP_MEMORY_SIZE + 1);
+    else if (first < CHIP_MEMORY_GUARD)
+        memcpy(machine->memory + CHIP_MEMORY_SIZE, machine->memory, CHIP_MEMORY_GUARD);
 }
 
 /**
@@ -84,13 +101,53 @@ uint8 util_chip_load_ROM(const char *fileName)
         return 1;
     }
 
-    fread(memory + 0x200, sizeof(memory), 1, file);
+    // anything past the end of memory is dropped
+    fread(chip->memory + 0x200, 1, CHIP_MEMORY_SIZE - 0x200, file);
+
+    fclose(file);
+
+    return 0;
+}
+
+/**
+ * @brief Read a ROM file without loading it, e.g. to hash it first
+ *
+ * @param fileName the file's path to grab the ROM from
+ * @param rom receives the ROM's bytes, room for the whole program space
+ * @param size receives the ROM's length, whatever exceeds the program space is dropped
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 util_chip_read_ROM(const char *fileName, uint8 *rom, uint32 *size)
+{
+    FILE *file = fopen(fileName, "rb");
+
+    if (file == 0)
+    {
+        perror("Failed to load ROM.\n");
+        return 1;
+    }
+
+    *size = fread(rom, 1, CHIP_MEMORY_SIZE - 0x200, file);
 
     fclose(file);
 
     return 0;
 }
 
+/**
+ * @brief Load a ROM already in memory, e.g. served from an archive
+ *
+ * @param rom the ROM's bytes
+ * @param size the ROM's length, whatever exceeds the program space is dropped
+ */
+void util_chip_load_ROM_bytes(const uint8 *rom, uint32 size)
+{
+    if (size > CHIP_MEMORY_SIZE - 0x200)
+        size = CHIP_MEMORY_SIZE - 0x200;
+
+    memcpy(chip->memory + 0x200, rom, size);
+}
+
 /**
  * @brief Given an opcode, executes the associated instruction
  *
@@ -99,7 +156,7 @@ uint8 util_chip_load_ROM(const char *fileName)
  */
 void util_chip_execute(uint16 opcode)
 {
-    PC += 2;
+    chip->PC += 2;
 
     switch ((opcode & 0xF000) >> 12)
     {
@@ -253,6 +310,126 @@ void util_chip_execute(uint16 opcode)
     }
 }
 
+/**
+ * @brief Fetch the instruction at PC and execute it
+ */
+void util_chip_cycle()
+{
+    uint16 opcode = (chip->memory[chip->PC & 0xFFF] << 8) + chip->memory[(chip->PC & 0xFFF) + 1];
+
+    chip->cycles++;
+    util_chip_execute(opcode);
+}
+
+/**
+ * @brief Whether the running chip is parked on Fx0A and no key was pressed since the last frame
+ *
+ * Such a chip would only run Fx0A again: every instruction of its next frame is a no-op.
+ */
+uint8 util_chip_suspended()
+{
+    if (!chip->waiting)
+        return 0;
+
+    for (uint8 i = 0; i < 0x10; i++)
+        if (chip->key_state[i] && !chip->key_prev[i])
+            return 0;
+
+    return 1;
+}
+
+/**
+ * @brief Emulate one frame: tick timers, run the frame's instructions and latch the keyboard
+ */
+void util_chip_frame()
+{
+    if (chip->delay_timer > 0)
+        chip->delay_timer--;
+
+    if (chip->sound_timer > 0)
+        chip->sound_timer--;
+
+    // fetch-execute cycle, skipped while the chip waits for a key that does not come
+    if (util_chip_suspended())
+        chip->cycles += CHIP_FRAME_CYCLES;
+    else
+        for (int i = 0; i < CHIP_FRAME_CYCLES; i++)
+            util_chip_cycle();
+
+    for (uint8 i = 0; i < 0x10; i++)
+        chip->key_prev[i] = chip->key_state[i];
+}
+
+/**
+ * @brief Counter-based random generator (Squares)
+ *
+ * Output i of a seed is computed directly from (seed, i), so a machine draws
+ * the same numbers on any thread and after any save or restore.
+ *
+ * @param seed the generator seed
+ * @param counter the index of the number to draw
+ * @return 32 random bits
+ */
+uint32 util_chip_random(uint64 seed, uint64 counter)
+{
+    // turn any seed into a key with well mixed digits
+    uint64 key = seed + 0x9E3779B97F4A7C15ULL;
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
+    key = (key ^ (key >> 31)) | 1;
+
+    uint64 x = counter * key, y = x, z = y + key;
+
+    x = x * x + y;
+    x = (x >> 32) | (x << 32);
+    x = x * x + z;
+    x = (x >> 32) | (x << 32);
+    x = x * x + y;
+    x = (x >> 32) | (x << 32);
+
+    return (x * x + z) >> 32;
+}
+
+/**
+ * @brief Hash a block of machine state
+ *
+ * Four independent lanes mix 8 bytes at a time, so hashing a whole machine
+ * costs a few hundred multiplies rather than one per byte.
+ *
+ * @param data the bytes to hash
+ * @param size the number of bytes
+ * @return 64-bit hash
+ */
+uint64 util_chip_hash(const void *data, uint32 size)
+{
+    const uint8 *bytes = data;
+    uint64 lane[4] = {0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0xCBF29CE484222325ULL};
+    uint32 i = 0;
+
+    for (; i + 32 <= size; i += 32)
+        for (uint8 l = 0; l < 4; l++)
+        {
+            uint64 word;
+            memcpy(&word, bytes + i + l * 8, 8);
+
+            lane[l] = (lane[l] ^ word) * 0xFF51AFD7ED558CCDULL;
+            lane[l] ^= lane[l] >> 29;
+        }
+
+    uint64 hash = size ^ lane[0] ^ (lane[1] << 17 | lane[1] >> 47) ^ (lane[2] << 31 | lane[2] >> 33) ^ (lane[3] << 47 | lane[3] >> 17);
+
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+
+    hash ^= hash >> 33;
+    hash *= 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 33;
+    hash *= 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 33;
+
+    return hash;
+}
+
 /**
  * Given an hexadecimal color, return the alpha channel
  *
@@ -0,0 +1,287 @@
+#include <chip/chip.h>
+#include <chip/chip_analysis.h>
+
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * @brief Whether the whole instruction at addr lies in the ROM
+ */
+static uint8 analysis_fits(const chip_analysis *rom, uint16 addr)
+{
+    return addr >= 0x200 && (uint32)addr + 2 <= 0x200 + rom->size;
+}
+
+/**
+ * @brief The opcode at addr, which must fit in the ROM
+ */
+uint16 util_analysis_opcode(const chip_analysis *rom, uint16 addr)
+{
+    return rom->bytes[addr - 0x200] << 8 | rom->bytes[addr - 0x200 + 1];
+}
+
+/**
+ * @brief Whether an instruction ends a block: it jumps, returns, skips or may run again
+ */
+uint8 util_analysis_ends(uint16 opcode)
+{
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        return opcode != 0x00E0;
+    case 0x1:
+    case 0x2:
+    case 0x3:
+    case 0x4:
+    case 0xB:
+        return 1;
+    case 0x5:
+    case 0x9:
+        return (opcode & 0xF) == 0;
+    case 0xE:
+        return (opcode & 0xFF) == 0x9E || (opcode & 0xFF) == 0xA1;
+    case 0xF:
+        return (opcode & 0xFF) == 0x0A;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief End of the block starting at start: after the first instruction that jumps, or at the next block
+ */
+uint16 util_analysis_extent(const chip_analysis *rom, uint16 start)
+{
+    uint16 addr = start;
+    uint16 opcode;
+
+    do
+        opcode = util_analysis_opcode(rom, addr), addr += 2;
+    while (!util_analysis_ends(opcode) && analysis_fits(rom, addr) && !(rom->addr[addr] & CHIP_ADDR_LEADER));
+
+    return addr;
+}
+
+/**
+ * @brief Whether addr is read both as code and as something else
+ *
+ * Either an instruction starts inside another one, as after a jump to an odd
+ * address, or I is pointed at code, as for sprites drawn from the program.
+ */
+uint8 util_analysis_overlap(const chip_analysis *rom, uint16 addr)
+{
+    uint8 flags = rom->addr[addr];
+
+    return (flags & CHIP_ADDR_CODE && flags & (CHIP_ADDR_OPERAND | CHIP_ADDR_DATA)) || (flags & CHIP_ADDR_OPERAND && flags & CHIP_ADDR_DATA);
+}
+
+/**
+ * @brief Mark a block start, queueing it if it was not one yet
+ */
+static void analysis_lead(chip_analysis *rom, uint16 addr, uint16 *work, uint32 *count)
+{
+    if (analysis_fits(rom, addr) && !(rom->addr[addr] & CHIP_ADDR_LEADER))
+    {
+        rom->addr[addr] |= CHIP_ADDR_LEADER;
+        work[(*count)++] = addr;
+    }
+}
+
+/**
+ * @brief Find every block reachable from 0x200 through direct jumps, calls and skips
+ *
+ * Return addresses of calls start blocks too; targets of Bnnn and RET are only
+ * known at run time: Bnnn is marked indirect, and what only it or RET reaches
+ * is left to the interpreter. Addresses I is loaded with are marked as data.
+ *
+ * @param rom receives the ROM, its blocks and its call graph
+ * @param bytes the ROM's bytes
+ * @param size the ROM's length, whatever exceeds the program space is dropped
+ */
+void util_analysis_walk(chip_analysis *rom, const uint8 *bytes, uint32 size)
+{
+    uint16 work[0x1000];
+    uint32 count = 0;
+
+    memset(rom, 0, sizeof(chip_analysis));
+    rom->size = size < sizeof(rom->bytes) ? size : sizeof(rom->bytes);
+    memcpy(rom->bytes, bytes, rom->size);
+
+    analysis_lead(rom, 0x200, work, &count);
+
+    while (count)
+    {
+        uint16 addr = work[--count];
+
+        // code already followed from another block goes on the same way
+        for (; analysis_fits(rom, addr) && !(rom->addr[addr] & CHIP_ADDR_CODE); addr += 2)
+        {
+            uint16 opcode = util_analysis_opcode(rom, addr), nnn = opcode & 0x0FFF;
+
+            rom->addr[addr] |= CHIP_ADDR_CODE;
+            rom->addr[addr + 1] |= CHIP_ADDR_OPERAND;
+            rom->instructions++;
+
+            if (opcode >> 12 == 0xA)
+                rom->addr[nnn] |= CHIP_ADDR_DATA;
+
+            if (!util_analysis_ends(opcode))
+                continue;
+
+            switch (opcode >> 12)
+            {
+            case 0x0:
+                if (opcode != 0x00EE)
+                    analysis_lead(rom, nnn, work, &count);
+                break;
+            case 0x1:
+                analysis_lead(rom, nnn, work, &count);
+                break;
+            case 0x2:
+                rom->call[rom->calls++] = (chip_call){addr, nnn};
+                rom->addr[nnn] |= CHIP_ADDR_SUBROUTINE;
+                analysis_lead(rom, nnn, work, &count);
+                analysis_lead(rom, addr + 2, work, &count);
+                break;
+            case 0xB:
+                rom->addr[addr] |= CHIP_ADDR_INDIRECT;
+                rom->indirect++;
+                break;
+            case 0xF:
+                // Fx0A runs again until a key is pressed
+                analysis_lead(rom, addr, work, &count);
+                analysis_lead(rom, addr + 2, work, &count);
+                break;
+            default:
+                analysis_lead(rom, addr + 2, work, &count);
+                analysis_lead(rom, addr + 4, work, &count);
+                break;
+            }
+
+            break;
+        }
+    }
+
+    for (uint32 addr = 0x200; addr < 0x1000; addr++)
+    {
+        rom->blocks += (rom->addr[addr] & CHIP_ADDR_LEADER) != 0;
+        rom->subroutines += (rom->addr[addr] & CHIP_ADDR_SUBROUTINE) != 0;
+        rom->overlaps += util_analysis_overlap(rom, addr);
+    }
+
+    // calls sorted by call site, for listings
+    for (uint32 i = 1; i < rom->calls; i++)
+        for (uint32 j = i; j > 0 && rom->call[j - 1].from > rom->call[j].from; j--)
+        {
+            chip_call swap = rom->call[j];
+            rom->call[j] = rom->call[j - 1];
+            rom->call[j - 1] = swap;
+        }
+}
+
+/**
+ * @brief Write the assembly of an opcode, in the notation of the instruction comments
+ */
+void util_analysis_mnemonic(uint16 opcode, char *text, size_t size)
+{
+    uint8 x = (opcode >> 8) & 0xF, y = (opcode >> 4) & 0xF, kk = opcode & 0xFF, n = opcode & 0xF;
+    uint16 nnn = opcode & 0xFFF;
+    static const char *alu[] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN"};
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        snprintf(text, size, opcode == 0x00E0 ? "CLS" : opcode == 0x00EE ? "RET" : "SYS 0x%03X", nnn);
+        return;
+    case 0x1:
+        snprintf(text, size, "JP 0x%03X", nnn);
+        return;
+    case 0x2:
+        snprintf(text, size, "CALL 0x%03X", nnn);
+        return;
+    case 0x3:
+        snprintf(text, size, "SE V%X, 0x%02X", x, kk);
+        return;
+    case 0x4:
+        snprintf(text, size, "SNE V%X, 0x%02X", x, kk);
+        return;
+    case 0x5:
+        if (n == 0)
+            snprintf(text, size, "SE V%X, V%X", x, y);
+        else
+            snprintf(text, size, "DW 0x%04X", opcode);
+        return;
+    case 0x6:
+        snprintf(text, size, "LD V%X, 0x%02X", x, kk);
+        return;
+    case 0x7:
+        snprintf(text, size, "ADD V%X, 0x%02X", x, kk);
+        return;
+    case 0x8:
+        if (n < 8)
+            snprintf(text, size, "%s V%X, V%X", alu[n], x, y);
+        else if (n == 0xE)
+            snprintf(text, size, "SHL V%X, V%X", x, y);
+        else
+            snprintf(text, size, "DW 0x%04X", opcode);
+        return;
+    case 0x9:
+        if (n == 0)
+            snprintf(text, size, "SNE V%X, V%X", x, y);
+        else
+            snprintf(text, size, "DW 0x%04X", opcode);
+        return;
+    case 0xA:
+        snprintf(text, size, "LD I, 0x%03X", nnn);
+        return;
+    case 0xB:
+        snprintf(text, size, "JP V0, 0x%03X", nnn);
+        return;
+    case 0xC:
+        snprintf(text, size, "RND V%X, 0x%02X", x, kk);
+        return;
+    case 0xD:
+        snprintf(text, size, "DRW V%X, V%X, %u", x, y, n);
+        return;
+    case 0xE:
+        if (kk == 0x9E || kk == 0xA1)
+            snprintf(text, size, "%s V%X", kk == 0x9E ? "SKP" : "SKNP", x);
+        else
+            snprintf(text, size, "DW 0x%04X", opcode);
+        return;
+    default:
+        switch (kk)
+        {
+        case 0x07:
+            snprintf(text, size, "LD V%X, DT", x);
+            return;
+        case 0x0A:
+            snprintf(text, size, "LD V%X, K", x);
+            return;
+        case 0x15:
+            snprintf(text, size, "LD DT, V%X", x);
+            return;
+        case 0x18:
+            snprintf(text, size, "LD ST, V%X", x);
+            return;
+        case 0x1E:
+            snprintf(text, size, "ADD I, V%X", x);
+            return;
+        case 0x29:
+            snprintf(text, size, "LD F, V%X", x);
+            return;
+        case 0x33:
+            snprintf(text, size, "LD B, V%X", x);
+            return;
+        case 0x55:
+            snprintf(text, size, "LD [I], V%X", x);
+            return;
+        case 0x65:
+            snprintf(text, size, "LD V%X, [I]", x);
+            return;
+        default:
+            snprintf(text, size, "DW 0x%04X", opcode);
+            return;
+        }
+    }
+}
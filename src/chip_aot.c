@@ -0,0 +1,160 @@
+#include <chip/chip.h>
+#include <chip/chip_analysis.h>
+#include <chip/chip_aot.h>
+#include <chip/chip_translate.h>
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// temporary files of translations in progress, unique within the process
+static uint32 aot_sequence;
+
+/**
+ * @brief Whether snprintf wrote all of its output into a buffer of size bytes
+ *
+ * @param length what snprintf returned
+ */
+static uint8 aot_fits(int length, size_t size)
+{
+    return length >= 0 && (size_t)length < size;
+}
+
+/**
+ * @brief Translate a ROM and compile it to a shared object at path
+ *
+ * The object is written under a temporary name and renamed into place, so
+ * processes compiling the same ROM at once never load a partial file.
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+static uint8 aot_compile(const char *path, const uint8 *rom, uint32 size)
+{
+    static _Thread_local chip_translation translation;
+    char source[4096], object[4096], command[16384];
+    uint32 sequence = __atomic_fetch_add(&aot_sequence, 1, __ATOMIC_RELAXED);
+    const char *cc = getenv("CHIP_AOT_CC"), *include = getenv("CHIP_AOT_INCLUDE");
+
+    include = include ? include : CHIP_AOT_INCLUDE;
+
+    // paths go to the shell between single quotes, which they cannot contain
+    if (strchr(path, '\'') || strchr(include, '\''))
+    {
+        fprintf(stderr, "Error while compiling translation: quote in %s or %s\n", path, include);
+        return 1;
+    }
+
+    if (!aot_fits(snprintf(source, sizeof(source), "%s.%d.%lu.c", path, getpid(), sequence), sizeof(source)) ||
+        !aot_fits(snprintf(object, sizeof(object), "%s.%d.%lu", path, getpid(), sequence), sizeof(object)) ||
+        !aot_fits(snprintf(command, sizeof(command), "%s -I '%s' -o '%s' '%s'", cc ? cc : CHIP_AOT_CC, include, object, source), sizeof(command)))
+    {
+        fprintf(stderr, "Error while compiling translation: path too long in %s\n", path);
+        return 1;
+    }
+
+    FILE *file = fopen(source, "w");
+
+    if (file == 0)
+    {
+        perror("Failed to write translation.\n");
+        return 1;
+    }
+
+    util_analysis_walk(&translation.rom, rom, size);
+
+    uint8 error = util_translate_write(file, &translation, path, "chip_aot", 0);
+
+    if (fclose(file) || error)
+    {
+        fprintf(stderr, "Error while translating ROM: cannot write %s\n", source);
+        remove(source);
+        return 1;
+    }
+
+    error = system(command) != 0;
+    remove(source);
+
+    if (error || rename(object, path))
+    {
+        fprintf(stderr, "Error while compiling translation: %s failed\n", command);
+        remove(object);
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Load the native translation of a ROM, translating and compiling it on first use
+ *
+ * Translations are kept in dir, named after the hash of the ROM's bytes and
+ * CHIP_TRANSLATE_VERSION: a ROM seen before, by any process, is only mapped.
+ * The program must export its symbols (-rdynamic) for translations to reach the core.
+ *
+ * @param dir the cache directory
+ * @param rom the ROM's bytes
+ * @param size the ROM's length
+ * @return the translation, 0 if error occurred
+ */
+chip_aot *util_aot_open(const char *dir, const uint8 *rom, uint32 size)
+{
+    if (size > CHIP_MEMORY_SIZE - 0x200)
+        size = CHIP_MEMORY_SIZE - 0x200;
+
+    char path[4096];
+
+    if (!aot_fits(snprintf(path, sizeof(path), "%s/%016llx-%u.so", dir, util_chip_hash(rom, size), CHIP_TRANSLATE_VERSION), sizeof(path)))
+    {
+        fprintf(stderr, "Error while loading translation: path too long in %s\n", dir);
+        return 0;
+    }
+
+    chip_aot *aot = calloc(1, sizeof(chip_aot));
+
+    if (aot == 0)
+    {
+        fprintf(stderr, "Error while loading translation: out of memory\n");
+        return 0;
+    }
+
+    // a file that does not load, e.g. left by another build, is compiled again
+    if ((aot->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)) == 0)
+    {
+        if (aot_compile(path, rom, size))
+        {
+            free(aot);
+            return 0;
+        }
+
+        if ((aot->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)) == 0)
+        {
+            fprintf(stderr, "Error while loading translation: %s\n", dlerror());
+            free(aot);
+            return 0;
+        }
+    }
+
+    aot->load = (void (*)())dlsym(aot->handle, "chip_aot_load");
+    aot->run = (void (*)(uint32))dlsym(aot->handle, "chip_aot_run");
+    aot->frame = (void (*)())dlsym(aot->handle, "chip_aot_frame");
+
+    if (aot->load == 0 || aot->run == 0 || aot->frame == 0)
+    {
+        fprintf(stderr, "Error while loading translation: %s is not a translation\n", path);
+        util_aot_close(aot);
+        return 0;
+    }
+
+    return aot;
+}
+
+/**
+ * @brief Unload a translation
+ */
+void util_aot_close(chip_aot *aot)
+{
+    dlclose(aot->handle);
+    free(aot);
+}
@@ -0,0 +1,89 @@
+#include <chip/chip_cpu.h>
+
+#include <stdio.h>
+#include <string.h>
+
+static const char *const cpu_names[CHIP_CPU_LEVELS] = {"sse2", "avx2", "avx512"};
+
+// level set by util_cpu_force, CHIP_CPU_LEVELS when none is
+static uint8 cpu_forced = CHIP_CPU_LEVELS;
+
+/**
+ * @brief Whether the CPU running the program can execute kernels built for level
+ *
+ * Outside x86 only level 0 exists: kernels built for the compiler's default target.
+ *
+ * @param level the CHIP_CPU_ level to check
+ * @return 1 if supported, 0 otherwise
+ */
+uint8 util_cpu_supported(uint8 level)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    switch (level)
+    {
+    case CHIP_CPU_SSE2:
+        return __builtin_cpu_supports("sse2") != 0;
+    case CHIP_CPU_AVX2:
+        return __builtin_cpu_supports("avx2") != 0;
+    case CHIP_CPU_AVX512:
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl");
+    default:
+        return 0;
+    }
+#else
+    return level == 0;
+#endif
+}
+
+/**
+ * @brief The level kernels should be selected for: the forced one, else the best the CPU supports
+ */
+uint8 util_cpu_level()
+{
+    if (cpu_forced < CHIP_CPU_LEVELS)
+        return cpu_forced;
+
+    uint8 level = CHIP_CPU_LEVELS - 1;
+
+    while (level > 0 && !util_cpu_supported(level))
+        level--;
+
+    return level;
+}
+
+/**
+ * @brief Select kernels for the level called name from now on, e.g. to compare levels on one machine
+ *
+ * @param name the name of the level, as util_cpu_name gives it
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 util_cpu_force(const char *name)
+{
+    for (uint8 level = 0; level < CHIP_CPU_LEVELS; level++)
+    {
+        if (strcmp(name, cpu_names[level]) != 0)
+            continue;
+
+        if (!util_cpu_supported(level))
+        {
+            fprintf(stderr, "Error while selecting kernels: this CPU does not support %s\n", name);
+            return 1;
+        }
+
+        cpu_forced = level;
+        return 0;
+    }
+
+    fprintf(stderr, "Error while selecting kernels: unknown instruction set %s (sse2, avx2 or avx512)\n", name);
+    return 1;
+}
+
+/**
+ * @brief The name of a CHIP_CPU_ level
+ */
+const char *util_cpu_name(uint8 level)
+{
+    return level < CHIP_CPU_LEVELS ? cpu_names[level] : "unknown";
+}
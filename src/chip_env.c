@@ -0,0 +1,331 @@
+#include <chip/chip.h>
+#include <chip/chip_env.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief Load a ROM into a fresh environment
+ *
+ * @param fileName the file's path to grab the ROM from
+ * @return the environment, 0 if error occurred
+ */
+chip_env *util_env_create(const char *fileName)
+{
+    chip_env *env = aligned_alloc(64, sizeof(chip_env));
+
+    if (env == 0)
+    {
+        fprintf(stderr, "Error while creating environment: out of memory\n");
+        return 0;
+    }
+
+    memset(env, 0, sizeof(chip_env));
+
+    chip_state *caller = chip;
+    chip = &env->image;
+    util_chip_init();
+    uint8 error = util_chip_load_ROM(fileName);
+    chip = caller;
+
+    if (error)
+    {
+        free(env);
+        return 0;
+    }
+
+    util_env_reset(env);
+
+    return env;
+}
+
+/**
+ * @brief Set the reward and done hooks, either may be 0
+ *
+ * @param env the environment
+ * @param reward called after every step, 0 reward without it
+ * @param done called after every step, never done without it
+ * @param user argument forwarded to the hooks
+ */
+void util_env_hooks(chip_env *env, chip_reward reward, chip_done done, void *user)
+{
+    env->reward = reward;
+    env->done = done;
+    env->user = user;
+}
+
+/**
+ * @brief Set the random seed the environment starts from at every reset
+ *
+ * @param env the environment
+ * @param seed the seed of RND
+ */
+void util_env_seed(chip_env *env, uint64 seed)
+{
+    env->image.seed = seed;
+}
+
+/**
+ * @brief Restart the environment from its image
+ *
+ * @param env the environment
+ * @return the observation, valid until the next step or reset
+ */
+const uint8 *util_env_reset(chip_env *env)
+{
+    env->machine = env->image;
+    env->frames = 0;
+
+    return &env->machine.display[0][0];
+}
+
+/**
+ * @brief Whether a step with action would leave the environment's machine untouched
+ *
+ * True when the machine is parked on a key wait (Fx0A) and action presses no
+ * key that was up: every instruction it would run is the same wait.
+ *
+ * @param env the environment
+ * @param action key bitmask of the step
+ */
+uint8 util_env_suspended(const chip_env *env, uint16 action)
+{
+    if (!env->machine.waiting)
+        return 0;
+
+    for (uint8 k = 0; k < 0x10; k++)
+        if ((action >> k) & 1 && !env->machine.key_prev[k])
+            return 0;
+
+    return 1;
+}
+
+/**
+ * @brief Hold the keys of action for a number of frames
+ *
+ * A machine suspended on a key wait is not run: every frame would only tick
+ * its timers and repeat the wait, so the step counts both down at once and
+ * latches the keys. Hooks are called on every step, suspended or not, and
+ * see the same machine as if it had run.
+ *
+ * @param env the environment
+ * @param action key bitmask: bit k set holds key k down
+ * @param frames the frames to run
+ * @return the observation, reward and done flag after the last frame
+ */
+chip_step util_env_step(chip_env *env, uint16 action, uint32 frames)
+{
+    chip_state *machine = &env->machine;
+    uint8 suspended = util_env_suspended(env, action);
+
+    for (uint8 k = 0; k < 0x10; k++)
+        machine->key_state[k] = (action >> k) & 1;
+
+    if (suspended)
+    {
+        machine->delay_timer = machine->delay_timer > frames ? machine->delay_timer - frames : 0;
+        machine->sound_timer = machine->sound_timer > frames ? machine->sound_timer - frames : 0;
+        machine->cycles += (uint64)frames * CHIP_FRAME_CYCLES;
+
+        if (frames)
+            memcpy(machine->key_prev, machine->key_state, sizeof(machine->key_prev));
+    }
+    else
+    {
+        chip_state *caller = chip;
+        chip = machine;
+
+        for (uint32 f = 0; f < frames; f++)
+            util_chip_frame();
+
+        chip = caller;
+    }
+
+    env->frames += frames;
+
+    chip_step step = {.observation = &env->machine.display[0][0]};
+
+    if (env->reward)
+        step.reward = env->reward(&env->machine, env->user);
+
+    if (env->done)
+        step.done = env->done(&env->machine, env->user);
+
+    return step;
+}
+
+/**
+ * @brief Free an environment
+ *
+ * @param env the environment to free
+ */
+void util_env_destroy(chip_env *env)
+{
+    free(env);
+}
+
+// environment copied into every slot of a new vector
+typedef struct vec_env_origin
+{
+    chip_vec_env *vec;
+    const chip_env *first;
+} vec_env_origin;
+
+static void vec_env_place(uint32 index, void *arg)
+{
+    vec_env_origin *origin = arg;
+
+    origin->vec->env[index] = *origin->first;
+}
+
+/**
+ * @brief Load a ROM into count environments stepped on a pool of threads
+ *
+ * Every environment is first written by the worker that steps it, both
+ * working on fixed slices of the environments, so with pinned workers its
+ * machine sits in that worker's NUMA node.
+ *
+ * @param fileName the file's path to grab the ROM from
+ * @param count number of environments
+ * @param threads number of workers, 0 for one per online CPU
+ * @param pin 1 to pin every worker to its own CPU
+ * @return the environments, 0 if error occurred
+ */
+chip_vec_env *util_vec_env_create(const char *fileName, uint32 count, uint32 threads, uint8 pin)
+{
+    chip_env *first = util_env_create(fileName);
+
+    if (first == 0)
+        return 0;
+
+    chip_vec_env *vec = calloc(1, sizeof(chip_vec_env));
+
+    if (vec == 0 || count == 0 || (vec->env = aligned_alloc(64, count * sizeof(chip_env))) == 0 ||
+        (vec->result = calloc(count, sizeof(chip_step))) == 0 || (vec->ready = malloc(count)) == 0)
+    {
+        fprintf(stderr, "Error while creating environments: out of memory\n");
+        util_env_destroy(first);
+        util_vec_env_destroy(vec);
+        return 0;
+    }
+
+    vec->count = count;
+    vec->pool = util_pool_create(threads, pin);
+
+    if (vec->pool == 0)
+    {
+        util_env_destroy(first);
+        util_vec_env_destroy(vec);
+        return 0;
+    }
+
+    // place each environment from the worker that steps it
+    vec_env_origin origin = {vec, first};
+    util_pool_run_fixed(vec->pool, count, vec_env_place, &origin);
+
+    util_env_destroy(first);
+    util_vec_env_reset(vec);
+
+    return vec;
+}
+
+/**
+ * @brief Set the reward and done hooks of every environment
+ */
+void util_vec_env_hooks(chip_vec_env *vec, chip_reward reward, chip_done done, void *user)
+{
+    for (uint32 i = 0; i < vec->count; i++)
+        util_env_hooks(&vec->env[i], reward, done, user);
+}
+
+/**
+ * @brief Seed environment i with seed + i, so every environment draws its own numbers
+ */
+void util_vec_env_seed(chip_vec_env *vec, uint64 seed)
+{
+    for (uint32 i = 0; i < vec->count; i++)
+        util_env_seed(&vec->env[i], seed + i);
+}
+
+/**
+ * @brief Restart every environment; observations are vec->env[i].machine.display
+ */
+void util_vec_env_reset(chip_vec_env *vec)
+{
+    for (uint32 i = 0; i < vec->count; i++)
+    {
+        util_env_reset(&vec->env[i]);
+        vec->result[i] = (chip_step){.observation = &vec->env[i].machine.display[0][0]};
+    }
+}
+
+static void vec_env_run(chip_vec_env *vec, uint32 index)
+{
+    chip_env *env = &vec->env[index];
+
+    vec->result[index] = util_env_step(env, vec->action[index], vec->frames);
+
+    // finished episodes start over, like gym vector environments
+    if (vec->result[index].done)
+        util_env_reset(env);
+}
+
+static void vec_env_task(uint32 index, void *arg)
+{
+    chip_vec_env *vec = arg;
+
+    if (vec->ready[index])
+        vec_env_run(vec, index);
+}
+
+/**
+ * @brief Step every environment with its own action in one call
+ *
+ * Only environments not suspended on a key wait run on the pool, each on the
+ * worker it was placed by; the suspended ones are stepped in place, which
+ * costs a few stores and the hooks each.
+ * Environments whose episode is done, suspended or not, are reset right away;
+ * their result still carries the final reward and the done flag.
+ *
+ * @param vec the environments
+ * @param action one key bitmask per environment
+ * @param frames the frames to run
+ * @return one result per environment, valid until the next step
+ */
+const chip_step *util_vec_env_step(chip_vec_env *vec, const uint16 *action, uint32 frames)
+{
+    vec->action = action;
+    vec->frames = frames;
+    vec->ready_count = 0;
+
+    for (uint32 i = 0; i < vec->count; i++)
+    {
+        vec->ready[i] = !util_env_suspended(&vec->env[i], action[i]);
+
+        if (vec->ready[i])
+            vec->ready_count++;
+        else
+            vec_env_run(vec, i);
+    }
+
+    if (vec->ready_count)
+        util_pool_run_fixed(vec->pool, vec->count, vec_env_task, vec);
+
+    return vec->result;
+}
+
+/**
+ * @brief Stop the pool and free every environment
+ */
+void util_vec_env_destroy(chip_vec_env *vec)
+{
+    if (vec == 0)
+        return;
+
+    util_pool_destroy(vec->pool);
+    free(vec->env);
+    free(vec->result);
+    free(vec->ready);
+    free(vec);
+}
@@ -0,0 +1,299 @@
+#include <chip/chip.h>
+#include <chip/chip_fork.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// page ids are never reused, so a host can tell a page it holds from a new one at the same address
+static uint64 fork_page_id;
+
+// bytes of page p inside a machine
+static uint8 *fork_page_data(chip_state *machine, uint8 p)
+{
+    if (p < 0x10)
+        return machine->memory + p * CHIP_FORK_PAGE;
+
+    return &machine->display[0][0] + (p - 0x10) * CHIP_FORK_PAGE;
+}
+
+static chip_page *fork_page_new(const uint8 *data)
+{
+    chip_page *page = malloc(sizeof(chip_page));
+
+    if (page == 0)
+    {
+        fprintf(stderr, "Error while forking: out of memory\n");
+        return 0;
+    }
+
+    page->refs = 1;
+    page->id = __atomic_add_fetch(&fork_page_id, 1, __ATOMIC_RELAXED);
+    memcpy(page->data, data, CHIP_FORK_PAGE);
+    page->hash = util_chip_hash(page->data, CHIP_FORK_PAGE);
+
+    return page;
+}
+
+static void fork_page_release(chip_page *page)
+{
+    if (page && __atomic_sub_fetch(&page->refs, 1, __ATOMIC_ACQ_REL) == 0)
+        free(page);
+}
+
+// a page table without pages yet, so that one only partly filled can be released
+static chip_pages *fork_pages_new()
+{
+    chip_pages *pages = calloc(1, sizeof(chip_pages));
+
+    if (pages == 0)
+    {
+        fprintf(stderr, "Error while forking: out of memory\n");
+        return 0;
+    }
+
+    pages->refs = 1;
+
+    return pages;
+}
+
+static void fork_pages_release(chip_pages *pages)
+{
+    if (__atomic_sub_fetch(&pages->refs, 1, __ATOMIC_ACQ_REL) != 0)
+        return;
+
+    for (uint8 p = 0; p < CHIP_FORK_PAGES; p++)
+        fork_page_release(pages->page[p]);
+
+    free(pages);
+}
+
+// copy everything but memory and display
+#define FORK_REGISTERS(dst, src)                                    \
+    do                                                              \
+    {                                                               \
+        memcpy((dst)->stack, (src)->stack, sizeof((src)->stack));   \
+        memcpy((dst)->V, (src)->V, sizeof((src)->V));               \
+        (dst)->PC = (src)->PC;                                      \
+        (dst)->SP = (src)->SP;                                      \
+        (dst)->I = (src)->I;                                        \
+        (dst)->delay_timer = (src)->delay_timer;                    \
+        (dst)->sound_timer = (src)->sound_timer;                    \
+        memcpy((dst)->key_state, (src)->key_state, 0x10);           \
+        memcpy((dst)->key_prev, (src)->key_prev, 0x10);             \
+        (dst)->waiting = (src)->waiting;                            \
+        (dst)->quirks = (src)->quirks;                              \
+        (dst)->seed = (src)->seed;                                  \
+        (dst)->draws = (src)->draws;                                \
+        (dst)->cycles = (src)->cycles;                              \
+    } while (0)
+
+/**
+ * @brief Save a machine as the root of a search tree
+ *
+ * @param machine the machine to save
+ * @return the fork, with pages of its own, 0 if error occurred
+ */
+chip_fork *util_fork_capture(const chip_state *machine)
+{
+    chip_fork *node = malloc(sizeof(chip_fork));
+
+    if (node == 0)
+    {
+        fprintf(stderr, "Error while forking: out of memory\n");
+        return 0;
+    }
+
+    FORK_REGISTERS(node, machine);
+    node->pages = fork_pages_new();
+
+    if (node->pages == 0)
+    {
+        free(node);
+        return 0;
+    }
+
+    for (uint8 p = 0; p < CHIP_FORK_PAGES; p++)
+    {
+        node->pages->page[p] = fork_page_new(fork_page_data((chip_state *)machine, p));
+
+        if (node->pages->page[p] == 0)
+        {
+            util_fork_release(node);
+            return 0;
+        }
+    }
+
+    return node;
+}
+
+/**
+ * @brief Fork a saved machine
+ *
+ * The child shares the page table with its parent: only the registers are copied.
+ *
+ * @param parent the fork to copy
+ * @return the child, 0 if error occurred
+ */
+chip_fork *util_fork(const chip_fork *parent)
+{
+    chip_fork *child = malloc(sizeof(chip_fork));
+
+    if (child == 0)
+    {
+        fprintf(stderr, "Error while forking: out of memory\n");
+        return 0;
+    }
+
+    memcpy(child, parent, sizeof(chip_fork));
+    __atomic_add_fetch(&child->pages->refs, 1, __ATOMIC_RELAXED);
+
+    return child;
+}
+
+/**
+ * @brief Load a fork into the host's machine to run it
+ *
+ * Only pages the host does not already hold are copied, so moving between
+ * siblings costs the pages in which they differ.
+ *
+ * @param host the host to run on
+ * @param node the fork to load
+ */
+void util_fork_enter(chip_fork_host *host, const chip_fork *node)
+{
+    chip_state *machine = &host->machine;
+
+    FORK_REGISTERS(machine, node);
+
+    for (uint8 p = 0; p < CHIP_FORK_PAGES; p++)
+    {
+        const chip_page *page = node->pages->page[p];
+
+        if (host->held[p] != page->id || (machine->dirty & (1UL << p)))
+        {
+            memcpy(fork_page_data(machine, p), page->data, CHIP_FORK_PAGE);
+            host->held[p] = page->id;
+
+            if (p == 0)
+                util_chip_mirror(machine, 0, 0);
+        }
+    }
+
+    machine->dirty = 0;
+}
+
+/**
+ * @brief Save the host's machine as a child of the fork it entered
+ *
+ * The child shares the pages the machine did not write since entering parent;
+ * pages it wrote are copied into new ones.
+ *
+ * @param host the host that entered parent
+ * @param parent the fork the host entered
+ * @return the child, 0 if error occurred
+ */
+chip_fork *util_fork_commit(chip_fork_host *host, const chip_fork *parent)
+{
+    chip_state *machine = &host->machine;
+    chip_fork *child = util_fork(parent);
+
+    if (child == 0)
+        return 0;
+
+    FORK_REGISTERS(child, machine);
+
+    if (machine->dirty == 0)
+        return child;
+
+    // written pages get new copies in a page table of the child's own
+    chip_pages *pages = fork_pages_new();
+
+    if (pages == 0)
+    {
+        util_fork_release(child);
+        return 0;
+    }
+
+    for (uint8 p = 0; p < CHIP_FORK_PAGES; p++)
+    {
+        if (machine->dirty & (1UL << p))
+        {
+            pages->page[p] = fork_page_new(fork_page_data(machine, p));
+
+            // the machine stays dirty: entering any fork copies its pages again
+            if (pages->page[p] == 0)
+            {
+                fork_pages_release(pages);
+                util_fork_release(child);
+                return 0;
+            }
+
+            host->held[p] = pages->page[p]->id;
+        }
+        else
+        {
+            pages->page[p] = parent->pages->page[p];
+            __atomic_add_fetch(&pages->page[p]->refs, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    fork_pages_release(child->pages);
+    child->pages = pages;
+    machine->dirty = 0;
+
+    return child;
+}
+
+/**
+ * @brief Free a fork, and the pages no other fork shares
+ *
+ * @param node the fork to free
+ */
+void util_fork_release(chip_fork *node)
+{
+    if (node == 0)
+        return;
+
+    fork_pages_release(node->pages);
+    free(node);
+}
+
+/**
+ * @brief Hash the machine state of a fork
+ *
+ * Covers everything that decides how the machine continues: memory, display,
+ * registers, stack, timers, previous keys and random state, but not the keys
+ * currently held or the instruction count. Pages hash once when created, so
+ * this only mixes 24 page hashes with the registers.
+ *
+ * @param node the fork to hash
+ * @return 64-bit hash
+ */
+uint64 util_fork_hash(const chip_fork *node)
+{
+    uint8 registers[0x20 + 0x10 + 0x10 + 8 + 0x10];
+    uint8 *r = registers;
+
+    memcpy(r, node->stack, 0x20);
+    memcpy(r += 0x20, node->V, 0x10);
+    memcpy(r += 0x10, node->key_prev, 0x10);
+    r += 0x10;
+    *r++ = node->PC >> 8;
+    *r++ = node->PC;
+    *r++ = node->I >> 8;
+    *r++ = node->I;
+    *r++ = node->SP;
+    *r++ = node->delay_timer;
+    *r++ = node->sound_timer;
+    *r++ = 0;
+    memcpy(r, &node->seed, 8);
+    memcpy(r + 8, &node->draws, 8);
+
+    uint64 hash = util_chip_hash(registers, sizeof(registers));
+
+    for (uint8 p = 0; p < CHIP_FORK_PAGES; p++)
+        hash = (hash ^ node->pages->page[p]->hash) * 0x9E3779B97F4A7C15ULL + p;
+
+    return hash ^ hash >> 31;
+}
@@ -1,3 +1,4 @@
+#include <chip/chip.h>
 #include <chip/chip_datatype.h>
 #include <chip/chip_instructions.h>
 #include <chip/chip_specifications.h>
@@ -9,7 +10,7 @@
  */
 void SYS(uint16 addr)
 {
-    PC = addr;
+    chip->PC = addr;
 }
 
 /**
@@ -19,7 +20,9 @@ void CLS()
 {
     for (int i = 0; i < 32; i++)
         for (int j = 0; j < 64; j++)
-            display[i][j] = 0;
+            chip->display[i][j] = 0;
+
+    chip->dirty |= 0xFF0000;
 }
 
 /**
@@ -29,7 +32,8 @@ void CLS()
  */
 void RET()
 {
-    PC = stack[SP--];
+    chip->PC = chip->stack[chip->SP];
+    chip->SP = (chip->SP - 1) & 0xF;
 }
 
 /**
@@ -41,7 +45,7 @@ void RET()
  */
 void JP(uint16 addr)
 {
-    PC = addr;
+    chip->PC = addr;
 }
 
 /**
@@ -53,8 +57,9 @@ void JP(uint16 addr)
  */
 void CALL(uint16 addr)
 {
-    stack[++SP] = PC;
-    PC = addr;
+    chip->SP = (chip->SP + 1) & 0xF;
+    chip->stack[chip->SP] = chip->PC;
+    chip->PC = addr;
 }
 
 /**
@@ -67,8 +72,8 @@ void CALL(uint16 addr)
  */
 void SE(uint8 reg, uint8 val)
 {
-    if (V[reg] == val)
-        PC += 2;
+    if (chip->V[reg] == val)
+        chip->PC += 2;
 }
 
 /**
@@ -80,8 +85,8 @@ void SE(uint8 reg, uint8 val)
  */
 void SNE(uint8 reg, uint8 val)
 {
-    if (V[reg] != val)
-        PC += 2;
+    if (chip->V[reg] != val)
+        chip->PC += 2;
 }
 
 /**
@@ -94,8 +99,8 @@ void SNE(uint8 reg, uint8 val)
  */
 void SE2(uint8 regX, uint8 regY)
 {
-    if (V[regX] == V[regY])
-        PC += 2;
+    if (chip->V[regX] == chip->V[regY])
+        chip->PC += 2;
 }
 
 /**
@@ -108,7 +113,7 @@ void SE2(uint8 regX, uint8 regY)
  */
 void LD(uint8 reg, uint8 val)
 {
-    V[reg] = val;
+    chip->V[reg] = val;
 }
 
 /**
@@ -121,7 +126,7 @@ void LD(uint8 reg, uint8 val)
  */
 void ADD(uint8 reg, uint8 val)
 {
-    V[reg] += val;
+    chip->V[reg] += val;
 }
 
 /**
@@ -134,21 +139,24 @@ void ADD(uint8 reg, uint8 val)
  */
 void LD2(uint8 regX, uint8 regY)
 {
-    V[regX] = V[regY];
+    chip->V[regX] = chip->V[regY];
 }
 
 /**
  * 8xy1 - Set Vx = Vx OR Vy.
  *
  * Performs a bitwise OR on the values of Vx and Vy, then stores the result in Vx.
+ * VF is cleared, as are 8xy2 and 8xy3, unless CHIP_QUIRK_LOGIC is set.
  *
  * @param regX the register to store the value in
  * @param regY the register to grab the value from
  */
 void OR(uint8 regX, uint8 regY)
 {
-    V[regX] |= V[regY];
-    V[0xF] = 0;
+    chip->V[regX] |= chip->V[regY];
+
+    if (!(chip->quirks & CHIP_QUIRK_LOGIC))
+        chip->V[0xF] = 0;
 }
 
 /**
@@ -161,8 +169,10 @@ void OR(uint8 regX, uint8 regY)
  */
 void AND(uint8 regX, uint8 regY)
 {
-    V[regX] &= V[regY];
-    V[0xF] = 0;
+    chip->V[regX] &= chip->V[regY];
+
+    if (!(chip->quirks & CHIP_QUIRK_LOGIC))
+        chip->V[0xF] = 0;
 }
 
 /**
@@ -175,8 +185,10 @@ void AND(uint8 regX, uint8 regY)
  */
 void XOR(uint8 regX, uint8 regY)
 {
-    V[regX] ^= V[regY];
-    V[0xF] = 0;
+    chip->V[regX] ^= chip->V[regY];
+
+    if (!(chip->quirks & CHIP_QUIRK_LOGIC))
+        chip->V[0xF] = 0;
 }
 
 /**
@@ -192,12 +204,12 @@ void XOR(uint8 regX, uint8 regY)
 void ADD2(uint8 regX, uint8 regY)
 {
     uint8 overflow = 0;
-    if ((uint16)V[regX] + (uint16)V[regY] > 255)
+    if ((uint16)chip->V[regX] + (uint16)chip->V[regY] > 255)
         overflow = 1;
 
-    V[regX] += V[regY];
+    chip->V[regX] += chip->V[regY];
 
-    V[0xF] = overflow;
+    chip->V[0xF] = overflow;
 }
 
 /**
@@ -211,31 +223,34 @@ void ADD2(uint8 regX, uint8 regY)
 void SUB(uint8 regX, uint8 regY)
 {
     uint8 underflow = 0;
-    if (V[regX] > V[regY])
+    if (chip->V[regX] > chip->V[regY])
         underflow = 1;
 
-    V[regX] -= V[regY];
+    chip->V[regX] -= chip->V[regY];
 
-    V[0xF] = underflow;
+    chip->V[0xF] = underflow;
 }
 
 /**
  * 8xy6 - Set Vx = Vy SHR 1.
  *
  * If the least-significant bit of Vy is 1, then VF is set to 1, otherwise 0. Then Vy is divided by 2 and the result is stored in Vx.
+ * With CHIP_QUIRK_SHIFT, Vx is shifted instead of Vy.
  *
  * @param regX the register to store the value in
  * @param regY the register to grab the value from
  */
 void SHR(uint8 regX, uint8 regY)
 {
+    uint8 value = chip->quirks & CHIP_QUIRK_SHIFT ? chip->V[regX] : chip->V[regY];
+
     uint8 lsb = 0;
-    if (V[regY] & 0x01)
+    if (value & 0x01)
         lsb = 1;
 
-    V[regX] = V[regY] >> 1;
+    chip->V[regX] = value >> 1;
 
-    V[0xF] = lsb;
+    chip->V[0xF] = lsb;
 }
 
 /**
@@ -249,31 +264,34 @@ void SHR(uint8 regX, uint8 regY)
 void SUBN(uint8 regX, uint8 regY)
 {
     uint8 not_borrow = 0;
-    if (V[regY] > V[regX])
+    if (chip->V[regY] > chip->V[regX])
         not_borrow = 1;
 
-    V[regX] = V[regY] - V[regX];
+    chip->V[regX] = chip->V[regY] - chip->V[regX];
 
-    V[0xF] = not_borrow;
+    chip->V[0xF] = not_borrow;
 }
 
 /**
  * 8xyE - Set Vx = Vx SHL 1.
  *
  * If the most-significant bit of Vy is 1, then VF is set to 1, otherwise 0. Then Vy is multiplied by 2 and the result is stored in Vx.
+ * With CHIP_QUIRK_SHIFT, Vx is shifted instead of Vy.
  *
  * @param regX the register to store the value in
  * @param regY the register to grab the value from
  */
 void SHL(uint8 regX, uint8 regY)
 {
+    uint8 value = chip->quirks & CHIP_QUIRK_SHIFT ? chip->V[regX] : chip->V[regY];
+
     uint8 msb = 0;
-    if (V[regY] & 0x80)
+    if (value & 0x80)
         msb = 1;
 
-    V[regX] = V[regY] << 1;
+    chip->V[regX] = value << 1;
 
-    V[0xF] = msb;
+    chip->V[0xF] = msb;
 }
 
 /**
@@ -286,8 +304,8 @@ void SHL(uint8 regX, uint8 regY)
  */
 void SNE2(uint8 regX, uint8 regY)
 {
-    if (V[regX] != V[regY])
-        PC += 2;
+    if (chip->V[regX] != chip->V[regY])
+        chip->PC += 2;
 }
 
 /**
@@ -299,52 +317,46 @@ void SNE2(uint8 regX, uint8 regY)
  */
 void LD3(uint16 addr)
 {
-    I = addr;
+    chip->I = addr;
 }
 
 /**
  * Bnnn - Jump to location nnn + V0.
  *
  * The program counter is set to nnn plus the value of V0.
+ * With CHIP_QUIRK_JUMP, this is Bxnn: the program counter is set to xnn plus the value of Vx.
  *
  * @param addr the address to jump to
  */
 void JP2(uint16 addr)
 {
-    // PC = addr + V[(addr & 0xF0) >> 4];
-    PC = addr + V[0x0];
+    chip->PC = addr + chip->V[chip->quirks & CHIP_QUIRK_JUMP ? (addr & 0x0F00) >> 8 : 0x0];
 }
 
 /**
  * Cxkk - Set Vx = random byte AND kk.
  *
  * The interpreter generates a random number from 0 to 255, which is then ANDed with the value kk. The results are stored in Vx.
+ * The number depends only on the machine's seed and how many numbers it drew before.
  *
  * @param reg the register to store the value in
  * @param val the value to & to the value
  */
 void RND(uint8 reg, uint8 val)
 {
-    next = next * 4097 + 127;
-    V[reg] = (next % 0x100) & val;
+    chip->V[reg] = util_chip_random(chip->seed, chip->draws++) & val;
 }
 
 /**
- * Dxyn - Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
+ * @brief Draw a sprite, the same as Dxyn, telling whether it erased any pixel
  *
- * The interpreter reads n bytes from memory, starting at the address stored in I.
- * These bytes are then displayed as sprites on screen at coordinates (Vx, Vy).
- * Sprites are XORed onto the existing screen. If this causes any pixels to be erased, VF is set to 1, otherwise it is set to 0.
- * If the sprite is positioned so part of it is outside the coordinates of the display, it wraps around to the opposite side of the screen.
- *
- * @param regX the register with x coordinate
- * @param regY the register with y coordinate
- * @param n number of sprites to draw
+ * @param collide whether to look for erased pixels at all
+ * @return 1 if a pixel was erased, 0 otherwise or without collide
  */
-void DRW(uint8 regX, uint8 regY, uint8 n)
+static inline uint8 draw(uint8 regX, uint8 regY, uint8 n, uint8 collide)
 {
-    uint8 vx = V[regX];
-    uint8 vy = V[regY];
+    uint8 vx = chip->V[regX];
+    uint8 vy = chip->V[regY];
 
     if (vx > 63 || vy > 31)
     {
@@ -356,19 +368,59 @@ void DRW(uint8 regX, uint8 regY, uint8 n)
 
     for (uint8 y = 0; y < n; y++)
     {
-        uint8 row = memory[I + y];
+        uint8 row = chip->memory[chip->I + y];
+        uint8 wrap = chip->quirks & CHIP_QUIRK_WRAP;
+        uint8 py = wrap ? (vy + y) & 0x1F : vy + y;
+
         for (uint8 x = 0; x < 8; x++)
         {
-            if (vx + x > 63 || vy + y > 31)
+            uint8 px = wrap ? (vx + x) & 0x3F : vx + x;
+
+            if (px > 63 || py > 31)
                 break;
             uint8 pixel = (row & (1 << (7 - x))) >> (7 - x);
-            if (display[vy + y][vx + x] && pixel)
+            if (collide && chip->display[py][px] && pixel)
                 collision = 1;
-            display[vy + y][vx + x] ^= pixel;
+            chip->display[py][px] ^= pixel;
         }
+
+        if (py < 0x20)
+            chip->dirty |= CHIP_DIRTY_DISPLAY(py);
     }
 
-    V[0xF] = collision;
+    return collision;
+}
+
+/**
+ * Dxyn - Display n-byte sprite starting at memory location I at (Vx, Vy), set VF = collision.
+ *
+ * The interpreter reads n bytes from memory, starting at the address stored in I.
+ * These bytes are then displayed as sprites on screen at coordinates (Vx, Vy).
+ * Sprites are XORed onto the existing screen. If this causes any pixels to be erased, VF is set to 1, otherwise it is set to 0.
+ * If the sprite is positioned so part of it is outside the coordinates of the display, it is clipped,
+ * or wraps around to the opposite side of the screen with CHIP_QUIRK_WRAP.
+ *
+ * @param regX the register with x coordinate
+ * @param regY the register with y coordinate
+ * @param n number of sprites to draw
+ */
+void DRW(uint8 regX, uint8 regY, uint8 n)
+{
+    chip->V[0xF] = draw(regX, regY, n, 1);
+}
+
+/**
+ * Dxyn with VF dead - Display the sprite like DRW, without collision detection.
+ *
+ * For translated code that overwrites VF before reading it; VF is left as it was.
+ *
+ * @param regX the register with x coordinate
+ * @param regY the register with y coordinate
+ * @param n number of sprites to draw
+ */
+void DRW_NOFLAG(uint8 regX, uint8 regY, uint8 n)
+{
+    draw(regX, regY, n, 0);
 }
 
 /**
@@ -380,8 +432,8 @@ void DRW(uint8 regX, uint8 regY, uint8 n)
  */
 void SKP(uint8 reg)
 {
-    if (key_state[V[reg]])
-        PC += 2;
+    if (chip->key_state[chip->V[reg] & 0xF])
+        chip->PC += 2;
 }
 
 /**
@@ -393,8 +445,8 @@ void SKP(uint8 reg)
  */
 void SKNP(uint8 reg)
 {
-    if (!key_state[V[reg]])
-        PC += 2;
+    if (!chip->key_state[chip->V[reg] & 0xF])
+        chip->PC += 2;
 }
 
 /**
@@ -406,7 +458,7 @@ void SKNP(uint8 reg)
  */
 void LD4(uint8 reg)
 {
-    V[reg] = delay_timer;
+    chip->V[reg] = chip->delay_timer;
 }
 
 /**
@@ -418,14 +470,16 @@ void LD4(uint8 reg)
  */
 void LD5(uint8 reg)
 {
-    V[reg] = 0;
+    chip->V[reg] = 0;
     for (int i = 0; i < 16; i++)
-        if (key_state[i] && !key_prev[i])
+        if (chip->key_state[i] && !chip->key_prev[i])
         {
-            V[reg] = i;
+            chip->V[reg] = i;
+            chip->waiting = 0;
             return;
         }
-    PC -= 2;
+    chip->PC -= 2;
+    chip->waiting = 1;
 }
 
 /**
@@ -437,7 +491,7 @@ void LD5(uint8 reg)
  */
 void LDDT(uint8 reg)
 {
-    delay_timer = V[reg];
+    chip->delay_timer = chip->V[reg];
 }
 
 /**
@@ -449,7 +503,7 @@ void LDDT(uint8 reg)
  */
 void LDST(uint8 reg)
 {
-    sound_timer = V[reg];
+    chip->sound_timer = chip->V[reg];
 }
 
 /**
@@ -461,7 +515,7 @@ void LDST(uint8 reg)
  */
 void ADDI(uint8 reg)
 {
-    I += V[reg];
+    chip->I = (chip->I + chip->V[reg]) & 0xFFF;
 }
 
 /**
@@ -473,7 +527,7 @@ void ADDI(uint8 reg)
  */
 void LDF(uint8 reg)
 {
-    I = V[reg] * 5;
+    chip->I = chip->V[reg] * 5;
 }
 
 /**
@@ -485,39 +539,56 @@ void LDF(uint8 reg)
  */
 void LDB(uint8 reg)
 {
-    memory[I] = V[reg] / 100;
-    memory[I + 1] = (V[reg] % 100) / 10;
-    memory[I + 2] = V[reg] % 10;
+    uint16 last = chip->I + 2;
+
+    chip->memory[chip->I] = chip->V[reg] / 100;
+    chip->memory[chip->I + 1] = (chip->V[reg] % 100) / 10;
+    chip->memory[last] = chip->V[reg] % 10;
+
+    chip->dirty |= CHIP_DIRTY_MEMORY(chip->I) | CHIP_DIRTY_MEMORY(last);
+
+    if (last >= CHIP_MEMORY_SIZE || chip->I < CHIP_MEMORY_GUARD)
+        util_chip_mirror(chip, chip->I, last);
 }
 
 /**
  * Fx55 - Store registers V0 through Vx in memory starting at location I.
  *
  * The interpreter copies the values of registers V0 through Vx into memory, starting at the address in I.
+ * I ends up past the last register, or unchanged with CHIP_QUIRK_MEMORY.
  *
  * @param reg the register to go through
  */
 void LDI(uint8 reg)
 {
+    uint16 last = chip->I + reg;
+
     for (int i = 0; i <= reg; i++)
-    {
-        memory[I] = V[i];
-        I++;
-    }
+        chip->memory[chip->I + i] = chip->V[i];
+
+    chip->dirty |= CHIP_DIRTY_MEMORY(chip->I) | CHIP_DIRTY_MEMORY(last);
+
+    // bytes written past the end land in the guard, bytes written at the start are missing from it
+    if (last >= CHIP_MEMORY_SIZE || chip->I < CHIP_MEMORY_GUARD)
+        util_chip_mirror(chip, chip->I, last);
+
+    if (!(chip->quirks & CHIP_QUIRK_MEMORY))
+        chip->I = (last + 1) & 0xFFF;
 }
 
 /**
  * Fx65 - Read registers V0 through Vx from memory starting at location I.
  *
  * The interpreter reads values from memory starting at location I into registers V0 through Vx.
+ * I ends up past the last register, or unchanged with CHIP_QUIRK_MEMORY.
  *
  * @param reg the register to go through
  */
 void LD6(uint8 reg)
 {
     for (int i = 0; i <= reg; i++)
-    {
-        V[i] = memory[I];
-        I++;
-    }
+        chip->V[i] = chip->memory[chip->I + i];
+
+    if (!(chip->quirks & CHIP_QUIRK_MEMORY))
+        chip->I = (chip->I + reg + 1) & 0xFFF;
 }
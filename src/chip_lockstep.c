@@ -0,0 +1,537 @@
+#include <chip/chip.h>
+#include <chip/chip_cpu.h>
+#include <chip/chip_lockstep.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 32 lanes of bytes: one AVX2 register, two SSE2 registers
+typedef uint8 lane8 __attribute__((vector_size(CHIP_LOCKSTEP_WIDTH)));
+
+// 16 lanes of bytes and words, for operations mixing V with PC or I
+typedef uint8 half8 __attribute__((vector_size(CHIP_LOCKSTEP_WIDTH / 2)));
+typedef signed char half8s __attribute__((vector_size(CHIP_LOCKSTEP_WIDTH / 2)));
+typedef uint16 half16 __attribute__((vector_size(CHIP_LOCKSTEP_WIDTH)));
+typedef short half16s __attribute__((vector_size(CHIP_LOCKSTEP_WIDTH)));
+
+#define HALF (CHIP_LOCKSTEP_WIDTH / 2)
+
+// widen a 16 lane byte mask to words
+#define WIDEN(mask) ((half16)__builtin_convertvector((half8s)(mask), half16s))
+
+// mask ? a : b
+#define BLEND(mask, a, b) (((mask) & (a)) | (~(mask) & (b)))
+
+// vector code goes whole into every kernel, to be built for the kernel's instruction set
+#define LOCKSTEP_INLINE static inline __attribute__((always_inline))
+
+// the vector parts of the engine, built once for every CHIP_CPU_ level
+typedef struct lockstep_kernel
+{
+    // select the lanes fetching opcode at lead and run it on them: the lanes run, 0 if it must run lane by lane
+    uint32 (*step)(chip_lockstep *, uint16, uint16);
+
+    // count down the timers of every lane
+    void (*timers)(chip_lockstep *);
+} lockstep_kernel;
+
+static const lockstep_kernel lockstep_kernels[CHIP_CPU_LEVELS];
+
+/**
+ * @brief Allocate lockstep machines, every lane starting as a copy of image
+ *
+ * @param image the machine every lane starts from
+ * @param lanes number of machines
+ * @return the lockstep machines, 0 if error occurred
+ */
+chip_lockstep *util_lockstep_create(const chip_state *image, uint32 lanes)
+{
+    chip_lockstep *ls = calloc(1, sizeof(chip_lockstep));
+
+    if (ls == 0 || lanes == 0)
+    {
+        fprintf(stderr, "Error while creating lockstep machines: out of memory\n");
+        free(ls);
+        return 0;
+    }
+
+    ls->lanes = lanes;
+    ls->quirks = image->quirks;
+    ls->kernel = util_cpu_level();
+    ls->stride = (lanes + CHIP_LOCKSTEP_WIDTH - 1) / CHIP_LOCKSTEP_WIDTH * CHIP_LOCKSTEP_WIDTH;
+
+    ls->V = aligned_alloc(64, 0x10 * ls->stride);
+    ls->PC = aligned_alloc(64, ls->stride * sizeof(uint16));
+    ls->I = aligned_alloc(64, ls->stride * sizeof(uint16));
+    ls->delay_timer = aligned_alloc(64, ls->stride);
+    ls->sound_timer = aligned_alloc(64, ls->stride);
+    ls->mask = aligned_alloc(64, ls->stride);
+    ls->ran = aligned_alloc(64, ls->stride);
+    ls->machine = aligned_alloc(64, lanes * sizeof(chip_state));
+
+    if (!ls->V || !ls->PC || !ls->I || !ls->delay_timer || !ls->sound_timer || !ls->mask || !ls->ran || !ls->machine)
+    {
+        fprintf(stderr, "Error while creating lockstep machines: out of memory\n");
+        util_lockstep_destroy(ls);
+        return 0;
+    }
+
+    memset(ls->V, 0, 0x10 * ls->stride);
+    memset(ls->mask, 0, ls->stride);
+    memset(ls->delay_timer, 0, ls->stride);
+    memset(ls->sound_timer, 0, ls->stride);
+
+    // padding lanes never match a real PC, so they never join a group
+    for (uint32 lane = 0; lane < ls->stride; lane++)
+    {
+        ls->PC[lane] = 0xFFFF;
+        ls->I[lane] = 0;
+    }
+
+    for (uint32 lane = 0; lane < lanes; lane++)
+    {
+        ls->machine[lane] = *image;
+        util_lockstep_store(ls, lane);
+    }
+
+    ls->cycles = image->cycles;
+    ls->written_lo = 0xFFFF;
+    ls->written_hi = 0;
+
+    return ls;
+}
+
+/**
+ * @brief Gather a lane's registers into its machine and return it
+ *
+ * @param ls the lockstep machines
+ * @param lane the lane to read
+ * @return the lane's machine, up to date
+ */
+chip_state *util_lockstep_machine(chip_lockstep *ls, uint32 lane)
+{
+    chip_state *machine = &ls->machine[lane];
+
+    for (uint8 reg = 0; reg < 0x10; reg++)
+        machine->V[reg] = ls->V[reg * ls->stride + lane];
+
+    machine->PC = ls->PC[lane];
+    machine->I = ls->I[lane];
+    machine->delay_timer = ls->delay_timer[lane];
+    machine->sound_timer = ls->sound_timer[lane];
+    machine->cycles = ls->cycles;
+
+    return machine;
+}
+
+/**
+ * @brief Scatter a lane's machine registers back after it was modified
+ *
+ * @param ls the lockstep machines
+ * @param lane the lane to write
+ */
+void util_lockstep_store(chip_lockstep *ls, uint32 lane)
+{
+    chip_state *machine = &ls->machine[lane];
+
+    for (uint8 reg = 0; reg < 0x10; reg++)
+        ls->V[reg * ls->stride + lane] = machine->V[reg];
+
+    ls->PC[lane] = machine->PC;
+    ls->I[lane] = machine->I;
+    ls->delay_timer[lane] = machine->delay_timer;
+    ls->sound_timer[lane] = machine->sound_timer;
+}
+
+/**
+ * @brief Execute one instruction on a single lane with the interpreter
+ */
+static void lockstep_scalar(chip_lockstep *ls, uint32 lane)
+{
+    chip = util_lockstep_machine(ls, lane);
+
+    // remember what the lane writes: fetches from there may differ between lanes
+    uint16 opcode = (chip->memory[chip->PC & 0xFFF] << 8) + chip->memory[(chip->PC & 0xFFF) + 1];
+    uint16 first = chip->I, last = 0;
+
+    if ((opcode & 0xF0FF) == 0xF033)
+        last = first + 2;
+    else if ((opcode & 0xF0FF) == 0xF055)
+        last = first + ((opcode & 0x0F00) >> 8);
+
+    // writes past the end wrap around to the start of memory
+    if (last > 0xFFF)
+        first = 0, last = 0xFFF;
+
+    if (last)
+    {
+        if (first < ls->written_lo)
+            ls->written_lo = first;
+        if (last > ls->written_hi)
+            ls->written_hi = last;
+    }
+
+    util_chip_cycle();
+    util_lockstep_store(ls, lane);
+    ls->scalar++;
+}
+
+/**
+ * @brief Select the lanes at PC lead that fetch opcode and have not run yet
+ *
+ * @return the number of selected lanes
+ */
+LOCKSTEP_INLINE uint32 lockstep_mask(chip_lockstep *ls, uint16 lead, uint16 opcode)
+{
+    for (uint32 b = 0; b < ls->stride; b += HALF)
+    {
+        half16 equal = (half16)(*(half16 *)&ls->PC[b] == lead);
+        *(half8 *)&ls->mask[b] = (half8)__builtin_convertvector((half16s)equal, half8s) & ~*(half8 *)&ls->ran[b];
+    }
+
+    // memory at PC may only differ between lanes where some lane wrote
+    uint16 at = lead & 0xFFF, next = (lead + 1) & 0xFFF;
+    uint8 shared = (at < ls->written_lo || at > ls->written_hi) && (next < ls->written_lo || next > ls->written_hi);
+    uint32 count = 0;
+
+    for (uint32 lane = 0; lane < ls->lanes; lane++)
+    {
+        if (!ls->mask[lane])
+            continue;
+
+        if (!shared)
+        {
+            const uint8 *memory = ls->machine[lane].memory;
+            if (((memory[at] << 8) + memory[next]) != opcode)
+            {
+                ls->mask[lane] = 0;
+                continue;
+            }
+        }
+
+        count++;
+    }
+
+    return count;
+}
+
+// advance the PC of the selected lanes by 2, or 4 where skip is set
+LOCKSTEP_INLINE void lockstep_skip(chip_lockstep *ls, uint32 b, const half8 *skip)
+{
+    half16 mask = WIDEN(*(half8 *)&ls->mask[b]);
+    half16 *pc = (half16 *)&ls->PC[b];
+
+    *pc += mask & (2 + (WIDEN(*skip) & 2));
+}
+
+// advance the PC of every selected lane by 2
+LOCKSTEP_INLINE void lockstep_advance(chip_lockstep *ls)
+{
+    const half8 none = {0};
+
+    for (uint32 b = 0; b < ls->stride; b += HALF)
+        lockstep_skip(ls, b, &none);
+}
+
+/**
+ * @brief Execute opcode on all selected lanes at once
+ *
+ * @return 1 if the opcode has a vector form, 0 if it must run lane by lane
+ */
+LOCKSTEP_INLINE uint8 lockstep_vector(chip_lockstep *ls, uint16 opcode)
+{
+    uint8 x = (opcode & 0x0F00) >> 8;
+    uint8 y = (opcode & 0x00F0) >> 4;
+    uint8 kk = opcode & 0x00FF;
+    uint16 nnn = opcode & 0x0FFF;
+
+    uint8 *vx = ls->V + x * ls->stride;
+    uint8 *vy = ls->V + y * ls->stride;
+    uint8 *vf = ls->V + 0xF * ls->stride;
+
+    switch (opcode >> 12)
+    {
+    case 0x1:
+        for (uint32 b = 0; b < ls->stride; b += HALF)
+        {
+            half16 mask = WIDEN(*(half8 *)&ls->mask[b]);
+            half16 *pc = (half16 *)&ls->PC[b];
+            *pc = BLEND(mask, nnn, *pc);
+        }
+        return 1;
+    case 0x3:
+    case 0x4:
+    case 0x5:
+    case 0x9:
+        if ((opcode >> 12 == 0x5 || opcode >> 12 == 0x9) && (opcode & 0x000F))
+            return 0;
+
+        for (uint32 b = 0; b < ls->stride; b += HALF)
+        {
+            half8 a = *(half8 *)&vx[b];
+            half8 equal = (opcode >> 12 == 0x3 || opcode >> 12 == 0x4)
+                              ? (half8)(a == kk)
+                              : (half8)(a == *(half8 *)&vy[b]);
+
+            if (opcode >> 12 == 0x4 || opcode >> 12 == 0x9)
+                equal = ~equal;
+
+            lockstep_skip(ls, b, &equal);
+        }
+        return 1;
+    case 0x6:
+    case 0x7:
+        for (uint32 b = 0; b < ls->stride; b += CHIP_LOCKSTEP_WIDTH)
+        {
+            lane8 mask = *(lane8 *)&ls->mask[b];
+            lane8 *r = (lane8 *)&vx[b];
+            *r = BLEND(mask, opcode >> 12 == 0x6 ? (lane8){0} + kk : *r + kk, *r);
+        }
+        lockstep_advance(ls);
+        return 1;
+    case 0x8:
+        if ((opcode & 0x000F) > 0x7 && (opcode & 0x000F) != 0xE)
+            return 0;
+
+        // 8xy0 leaves VF alone, and so do 8xy1-3 with CHIP_QUIRK_LOGIC; the rest set it, 8xy1-3 to 0
+        uint8 sets_flag = (opcode & 0x000F) != 0x0 && !((opcode & 0x000F) <= 0x3 && (ls->quirks & CHIP_QUIRK_LOGIC));
+
+        for (uint32 b = 0; b < ls->stride; b += CHIP_LOCKSTEP_WIDTH)
+        {
+            lane8 mask = *(lane8 *)&ls->mask[b];
+            lane8 a = *(lane8 *)&vx[b];
+            lane8 c = *(lane8 *)&vy[b];
+            lane8 shift = ls->quirks & CHIP_QUIRK_SHIFT ? a : c;
+            lane8 r, flag = {0};
+
+            switch (opcode & 0x000F)
+            {
+            case 0x0:
+                r = c;
+                break;
+            case 0x1:
+                r = a | c;
+                break;
+            case 0x2:
+                r = a & c;
+                break;
+            case 0x3:
+                r = a ^ c;
+                break;
+            case 0x4:
+                r = a + c;
+                flag = (lane8)(r < a) & 1;
+                break;
+            case 0x5:
+                r = a - c;
+                flag = (lane8)(a > c) & 1;
+                break;
+            case 0x6:
+                r = shift >> 1;
+                flag = shift & 1;
+                break;
+            case 0x7:
+                r = c - a;
+                flag = (lane8)(c > a) & 1;
+                break;
+            default:
+                r = shift << 1;
+                flag = shift >> 7;
+                break;
+            }
+
+            // VF is written last, as by the interpreter: with x = F the flag replaces the result
+            *(lane8 *)&vx[b] = BLEND(mask, r, a);
+
+            if (sets_flag)
+                *(lane8 *)&vf[b] = BLEND(mask, flag, *(lane8 *)&vf[b]);
+        }
+        lockstep_advance(ls);
+        return 1;
+    case 0xA:
+        for (uint32 b = 0; b < ls->stride; b += HALF)
+        {
+            half16 mask = WIDEN(*(half8 *)&ls->mask[b]);
+            half16 *i = (half16 *)&ls->I[b];
+            *i = BLEND(mask, nnn, *i);
+        }
+        lockstep_advance(ls);
+        return 1;
+    case 0xF:
+        switch (kk)
+        {
+        case 0x07:
+        case 0x15:
+        case 0x18:
+            for (uint32 b = 0; b < ls->stride; b += CHIP_LOCKSTEP_WIDTH)
+            {
+                lane8 mask = *(lane8 *)&ls->mask[b];
+                lane8 *dst = kk == 0x07 ? (lane8 *)&vx[b] : kk == 0x15 ? (lane8 *)&ls->delay_timer[b] : (lane8 *)&ls->sound_timer[b];
+                lane8 src = kk == 0x07 ? *(lane8 *)&ls->delay_timer[b] : *(lane8 *)&vx[b];
+                *dst = BLEND(mask, src, *dst);
+            }
+            lockstep_advance(ls);
+            return 1;
+        case 0x1E:
+        case 0x29:
+            for (uint32 b = 0; b < ls->stride; b += HALF)
+            {
+                half16 mask = WIDEN(*(half8 *)&ls->mask[b]);
+                half16 v = __builtin_convertvector(*(half8 *)&vx[b], half16);
+                half16 *i = (half16 *)&ls->I[b];
+                *i = BLEND(mask, kk == 0x1E ? (*i + v) & 0xFFF : v * 5, *i);
+            }
+            lockstep_advance(ls);
+            return 1;
+        default:
+            return 0;
+        }
+    default:
+        return 0;
+    }
+}
+
+LOCKSTEP_INLINE uint32 lockstep_step(chip_lockstep *ls, uint16 lead, uint16 opcode)
+{
+    uint32 count = lockstep_mask(ls, lead, opcode);
+
+    return count > 1 && lockstep_vector(ls, opcode) ? count : 0;
+}
+
+LOCKSTEP_INLINE void lockstep_timers(chip_lockstep *ls)
+{
+    for (uint32 b = 0; b < ls->stride; b += CHIP_LOCKSTEP_WIDTH)
+    {
+        lane8 *dt = (lane8 *)&ls->delay_timer[b];
+        lane8 *st = (lane8 *)&ls->sound_timer[b];
+
+        // comparisons yield 0xFF where true: adding it decrements
+        *dt += (lane8)(*dt != 0);
+        *st += (lane8)(*st != 0);
+    }
+}
+
+// a kernel of the vector code, built for the instruction sets in isa
+#define LOCKSTEP_KERNEL(name, isa)                                                                                  \
+    __attribute__((target(isa))) static uint32 lockstep_step_##name(chip_lockstep *ls, uint16 lead, uint16 opcode) \
+    {                                                                                                               \
+        return lockstep_step(ls, lead, opcode);                                                                     \
+    }                                                                                                               \
+                                                                                                                    \
+    __attribute__((target(isa))) static void lockstep_timers_##name(chip_lockstep *ls)                              \
+    {                                                                                                               \
+        lockstep_timers(ls);                                                                                        \
+    }
+
+// the kernel for the compiler's default target, SSE2 on x86-64
+static uint32 lockstep_step_sse2(chip_lockstep *ls, uint16 lead, uint16 opcode)
+{
+    return lockstep_step(ls, lead, opcode);
+}
+
+static void lockstep_timers_sse2(chip_lockstep *ls)
+{
+    lockstep_timers(ls);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+LOCKSTEP_KERNEL(avx2, "avx2")
+LOCKSTEP_KERNEL(avx512, "avx512f,avx512bw,avx512vl")
+
+static const lockstep_kernel lockstep_kernels[CHIP_CPU_LEVELS] = {{lockstep_step_sse2, lockstep_timers_sse2},
+                                                                  {lockstep_step_avx2, lockstep_timers_avx2},
+                                                                  {lockstep_step_avx512, lockstep_timers_avx512}};
+#else
+// only the compiler's default target elsewhere
+static const lockstep_kernel lockstep_kernels[CHIP_CPU_LEVELS] = {{lockstep_step_sse2, lockstep_timers_sse2}};
+#endif
+
+/**
+ * @brief Execute one instruction on every lane
+ *
+ * Lanes are grouped by PC, each group led by the first lane that has not run
+ * yet, so lanes that agree run together whichever lanes left them. A group
+ * runs the instruction with vector operations when it has a vector form;
+ * lanes alone at their PC, lanes past CHIP_LOCKSTEP_GROUPS groups, and
+ * instructions touching memory, stack, display or keyboard run lane by lane.
+ *
+ * @param ls the lockstep machines
+ */
+void util_lockstep_cycle(chip_lockstep *ls)
+{
+    chip_state *caller = chip;
+
+    memset(ls->ran, 0, ls->stride);
+
+    // lanes before first have all run
+    uint32 first = 0;
+
+    for (uint32 group = 0; group < CHIP_LOCKSTEP_GROUPS; group++)
+    {
+        while (first < ls->lanes && ls->ran[first])
+            first++;
+
+        if (first == ls->lanes)
+            break;
+
+        uint16 lead = ls->PC[first];
+        const uint8 *memory = ls->machine[first].memory;
+        uint16 opcode = (memory[lead & 0xFFF] << 8) + memory[(lead & 0xFFF) + 1];
+
+        uint32 count = lockstep_kernels[ls->kernel].step(ls, lead, opcode);
+
+        for (uint32 lane = first; lane < ls->lanes; lane++)
+            if (ls->mask[lane])
+            {
+                if (count == 0)
+                    lockstep_scalar(ls, lane);
+
+                ls->ran[lane] = 0xFF;
+            }
+    }
+
+    for (uint32 lane = first; lane < ls->lanes; lane++)
+        if (!ls->ran[lane])
+            lockstep_scalar(ls, lane);
+
+    ls->cycles++;
+    chip = caller;
+}
+
+/**
+ * @brief Emulate one frame on every lane: tick timers, run the frame's instructions and latch the keyboards
+ *
+ * @param ls the lockstep machines
+ */
+void util_lockstep_frame(chip_lockstep *ls)
+{
+    lockstep_kernels[ls->kernel].timers(ls);
+
+    for (int i = 0; i < CHIP_FRAME_CYCLES; i++)
+        util_lockstep_cycle(ls);
+
+    for (uint32 lane = 0; lane < ls->lanes; lane++)
+        memcpy(ls->machine[lane].key_prev, ls->machine[lane].key_state, 0x10);
+}
+
+/**
+ * @brief Free lockstep machines
+ *
+ * @param ls the lockstep machines to free
+ */
+void util_lockstep_destroy(chip_lockstep *ls)
+{
+    if (ls == 0)
+        return;
+
+    free(ls->V);
+    free(ls->PC);
+    free(ls->I);
+    free(ls->delay_timer);
+    free(ls->sound_timer);
+    free(ls->mask);
+    free(ls->ran);
+    free(ls->machine);
+    free(ls);
+}
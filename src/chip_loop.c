@@ -0,0 +1,70 @@
+#include <chip/chip_loop.h>
+
+#include <string.h>
+
+/**
+ * @brief Compare everything that decides how two machines continue
+ *
+ * The registers are compared first, so most frames never reach the memory
+ * and display comparison.
+ *
+ * @return 1 if the machines will behave the same, 0 otherwise
+ */
+static uint8 loop_same(const chip_state *a, const chip_state *b)
+{
+    return a->PC == b->PC &&
+           a->I == b->I &&
+           a->SP == b->SP &&
+           a->delay_timer == b->delay_timer &&
+           a->sound_timer == b->sound_timer &&
+           a->seed == b->seed &&
+           a->draws == b->draws &&
+           memcmp(a->V, b->V, sizeof(a->V)) == 0 &&
+           memcmp(a->key_state, b->key_state, sizeof(a->key_state)) == 0 &&
+           memcmp(a->key_prev, b->key_prev, sizeof(a->key_prev)) == 0 &&
+           memcmp(a->stack, b->stack, sizeof(a->stack)) == 0 &&
+           memcmp(a->memory, b->memory, sizeof(a->memory)) == 0 &&
+           memcmp(a->display, b->display, sizeof(a->display)) == 0;
+}
+
+/**
+ * @brief Start detecting loops from a machine's current state
+ *
+ * @param loop the detector
+ * @param machine the machine to watch
+ */
+void util_loop_init(chip_loop *loop, const chip_state *machine)
+{
+    loop->saved = *machine;
+    loop->power = 1;
+    loop->length = 0;
+}
+
+/**
+ * @brief Check a machine after one more frame
+ *
+ * With no input changes a machine is deterministic, so meeting a state seen
+ * before proves it will repeat forever. The saved state moves forward at
+ * every power of two frames (Brent), which finds any loop within a few times
+ * its length plus the frames before it starts.
+ *
+ * @param loop the detector
+ * @param machine the machine after the frame
+ * @return the loop length in frames, 0 while no loop was found
+ */
+uint64 util_loop_check(chip_loop *loop, const chip_state *machine)
+{
+    loop->length++;
+
+    if (loop_same(&loop->saved, machine))
+        return loop->length;
+
+    if (loop->length == loop->power)
+    {
+        loop->saved = *machine;
+        loop->power *= 2;
+        loop->length = 0;
+    }
+
+    return 0;
+}
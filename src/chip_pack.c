@@ -0,0 +1,225 @@
+#include <chip/chip_pack.h>
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Read a little-endian number of width bytes
+ */
+uint64 util_pack_read(const uint8 *bytes, uint8 width)
+{
+    uint64 value = 0;
+
+    for (uint8 b = width; b > 0; b--)
+        value = (value << 8) | bytes[b - 1];
+
+    return value;
+}
+
+/**
+ * @brief Write a little-endian number of width bytes
+ */
+void util_pack_write(uint8 *bytes, uint64 value, uint8 width)
+{
+    for (uint8 b = 0; b < width; b++, value >>= 8)
+        bytes[b] = value & 0xFF;
+}
+
+/**
+ * @brief Check that every entry of a mapped archive stays inside the file
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+static uint8 pack_check(const chip_pack *pack)
+{
+    uint64 names = (const uint8 *)pack->names - pack->base;
+    uint64 data = pack->data - pack->base;
+
+    for (uint32 i = 0; i < pack->count; i++)
+    {
+        const uint8 *entry = pack->index + (uint64)i * CHIP_PACK_ENTRY;
+        uint64 offset = util_pack_read(entry + 8, 4);
+        uint64 size = util_pack_read(entry + 12, 4);
+        uint64 name = util_pack_read(entry + 16, 4);
+        uint64 length = util_pack_read(entry + 20, 4);
+
+        if (data + offset + size > pack->size || names + name + length >= data || pack->names[name + length])
+            return 1;
+
+        if (util_pack_read(pack->by_name + (uint64)i * 4, 4) >= pack->count)
+            return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Map an archive built by chipEmu-pack
+ *
+ * The file is mapped once; ROMs served from it point straight into the mapping.
+ *
+ * @param fileName the archive's path
+ * @return the archive, 0 if error occurred
+ */
+chip_pack *util_pack_open(const char *fileName)
+{
+    int file = open(fileName, O_RDONLY);
+
+    if (file < 0)
+    {
+        perror("Failed to open ROM archive.\n");
+        return 0;
+    }
+
+    struct stat info;
+    if (fstat(file, &info) || info.st_size < CHIP_PACK_HEADER)
+    {
+        fprintf(stderr, "Error while opening ROM archive: %s is not an archive\n", fileName);
+        close(file);
+        return 0;
+    }
+
+    const uint8 *base = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+
+    if (base == MAP_FAILED)
+    {
+        perror("Failed to map ROM archive.\n");
+        return 0;
+    }
+
+    chip_pack *pack = calloc(1, sizeof(chip_pack));
+
+    if (pack == 0)
+    {
+        fprintf(stderr, "Error while opening ROM archive: out of memory\n");
+        munmap((void *)base, info.st_size);
+        return 0;
+    }
+
+    pack->base = base;
+    pack->size = info.st_size;
+    pack->count = util_pack_read(base + 8, 4);
+
+    uint64 index = util_pack_read(base + 16, 8);
+    uint64 names = util_pack_read(base + 24, 8);
+    uint64 data = util_pack_read(base + 32, 8);
+    uint64 by_name = index + (uint64)pack->count * CHIP_PACK_ENTRY;
+
+    if (memcmp(base, CHIP_PACK_MAGIC, 4) || util_pack_read(base + 4, 4) != CHIP_PACK_VERSION || index < CHIP_PACK_HEADER ||
+        by_name + (uint64)pack->count * 4 > names || names > data || data > pack->size)
+    {
+        fprintf(stderr, "Error while opening ROM archive: %s is not an archive\n", fileName);
+        util_pack_close(pack);
+        return 0;
+    }
+
+    pack->index = base + index;
+    pack->by_name = base + by_name;
+    pack->names = (const char *)base + names;
+    pack->data = base + data;
+
+    if (pack_check(pack))
+    {
+        fprintf(stderr, "Error while opening ROM archive: %s is corrupted\n", fileName);
+        util_pack_close(pack);
+        return 0;
+    }
+
+    return pack;
+}
+
+/**
+ * @brief Get the i-th ROM of an archive, in hash order
+ *
+ * @param pack the archive
+ * @param i the entry, below pack->count
+ * @param rom filled with pointers into the archive
+ */
+void util_pack_entry(const chip_pack *pack, uint32 i, chip_rom *rom)
+{
+    const uint8 *entry = pack->index + (uint64)i * CHIP_PACK_ENTRY;
+
+    rom->hash = util_pack_read(entry, 8);
+    rom->data = pack->data + util_pack_read(entry + 8, 4);
+    rom->size = util_pack_read(entry + 12, 4);
+    rom->name = pack->names + util_pack_read(entry + 16, 4);
+}
+
+/**
+ * @brief Look a ROM up by the hash of its bytes (util_chip_hash)
+ *
+ * @param pack the archive
+ * @param hash the hash to look for
+ * @param rom filled with the first ROM having that hash
+ * @return 1 if not found, 0 otherwise
+ */
+uint8 util_pack_find(const chip_pack *pack, uint64 hash, chip_rom *rom)
+{
+    uint32 low = 0, high = pack->count;
+
+    while (low < high)
+    {
+        uint32 middle = low + (high - low) / 2;
+
+        if (util_pack_read(pack->index + (uint64)middle * CHIP_PACK_ENTRY, 8) < hash)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low == pack->count || util_pack_read(pack->index + (uint64)low * CHIP_PACK_ENTRY, 8) != hash)
+        return 1;
+
+    util_pack_entry(pack, low, rom);
+    return 0;
+}
+
+/**
+ * @brief Look a ROM up by the name it was packed with
+ *
+ * @param pack the archive
+ * @param name the name to look for
+ * @param rom filled with the ROM
+ * @return 1 if not found, 0 otherwise
+ */
+uint8 util_pack_find_name(const chip_pack *pack, const char *name, chip_rom *rom)
+{
+    uint32 low = 0, high = pack->count;
+
+    while (low < high)
+    {
+        uint32 middle = low + (high - low) / 2;
+        util_pack_entry(pack, util_pack_read(pack->by_name + (uint64)middle * 4, 4), rom);
+        int order = strcmp(rom->name, name);
+
+        if (order == 0)
+            return 0;
+
+        if (order < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Unmap an archive; ROMs served from it are no longer valid
+ *
+ * @param pack the archive to close
+ */
+void util_pack_close(chip_pack *pack)
+{
+    if (pack == 0)
+        return;
+
+    munmap((void *)pack->base, pack->size);
+    free(pack);
+}
@@ -0,0 +1,380 @@
+#define _GNU_SOURCE
+
+#include <chip/chip_pool.h>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// worker queue: the indexes [head, tail) not yet claimed, one cache line per worker
+typedef struct chip_queue
+{
+    pthread_mutex_t lock;
+    uint32 head;
+    uint32 tail;
+} __attribute__((aligned(64))) chip_queue;
+
+typedef struct chip_worker
+{
+    chip_pool *pool;
+    uint32 index;
+    pthread_t thread;
+
+    // CPU the worker is pinned to and its NUMA node, 0 when not pinned
+    uint32 cpu;
+    uint32 node;
+} chip_worker;
+
+struct chip_pool
+{
+    uint32 threads;
+    chip_worker *worker;
+    chip_queue *queue;
+
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+
+    // current job
+    uint64 job;
+    uint32 busy;
+    uint8 quit;
+    chip_task task;
+    void *arg;
+
+    // whether workers keep to their own slice of the job, without stealing
+    uint8 fixed;
+};
+
+// index of the calling worker
+static _Thread_local uint32 pool_worker;
+
+/**
+ * @brief Claim the next index of the worker's own queue
+ *
+ * @return 1 if an index was claimed, 0 if the queue is empty
+ */
+static uint8 pool_take(chip_pool *pool, uint32 self, uint32 *index)
+{
+    chip_queue *queue = &pool->queue[self];
+    uint8 found = 0;
+
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail)
+    {
+        *index = queue->head++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&queue->lock);
+
+    return found;
+}
+
+/**
+ * @brief Steal the upper half of another worker's queue
+ *
+ * The first stolen index is returned, the rest becomes the worker's own queue.
+ *
+ * @return 1 if an index was stolen, 0 if every queue is empty
+ */
+static uint8 pool_steal(chip_pool *pool, uint32 self, uint32 *index)
+{
+    for (uint32 i = 1; i < pool->threads; i++)
+    {
+        chip_queue *victim = &pool->queue[(self + i) % pool->threads];
+        uint32 head = 0, tail = 0;
+
+        pthread_mutex_lock(&victim->lock);
+        if (victim->head < victim->tail)
+        {
+            tail = victim->tail;
+            head = tail - (tail - victim->head + 1) / 2;
+            victim->tail = head;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (head == tail)
+            continue;
+
+        chip_queue *queue = &pool->queue[self];
+
+        pthread_mutex_lock(&queue->lock);
+        queue->head = head + 1;
+        queue->tail = tail;
+        pthread_mutex_unlock(&queue->lock);
+
+        *index = head;
+        return 1;
+    }
+
+    return 0;
+}
+
+static void *pool_main(void *data)
+{
+    chip_worker *worker = data;
+    chip_pool *pool = worker->pool;
+    uint64 seen = 0;
+
+    pool_worker = worker->index;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        while (!pool->quit && pool->job == seen)
+            pthread_cond_wait(&pool->start, &pool->lock);
+
+        if (pool->quit)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return 0;
+        }
+
+        seen = pool->job;
+        chip_task task = pool->task;
+        void *arg = pool->arg;
+        uint8 fixed = pool->fixed;
+        pthread_mutex_unlock(&pool->lock);
+
+        uint32 index;
+        while (pool_take(pool, worker->index, &index) || (!fixed && pool_steal(pool, worker->index, &index)))
+            task(index, arg);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0)
+            pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/**
+ * @brief NUMA node of a CPU, 0 when the system does not tell
+ */
+static uint32 pool_node(uint32 cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%lu", cpu);
+
+    DIR *handle = opendir(path);
+    uint32 node = 0;
+
+    if (handle == 0)
+        return 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(handle)))
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+            node = strtoul(entry->d_name + 4, 0, 10);
+
+    closedir(handle);
+    return node;
+}
+
+/**
+ * @brief Start a pool of worker threads
+ *
+ * Pinned workers run on the CPUs the caller may run on, worker i on the i-th
+ * of them, from their first instruction: whatever they allocate and touch
+ * first (stack, thread-locals, machines) lands in their node's memory.
+ *
+ * @param threads number of workers, 0 for one per online CPU
+ * @param pin 1 to pin every worker to its own CPU
+ * @return the pool, 0 if error occurred
+ */
+chip_pool *util_pool_create(uint32 threads, uint8 pin)
+{
+    cpu_set_t allowed;
+    uint32 cpu[CPU_SETSIZE], cpus = 0;
+
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+    for (uint32 c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &allowed))
+            cpu[cpus++] = c;
+
+    if (threads == 0)
+        threads = sysconf(_SC_NPROCESSORS_ONLN) > 0 ? sysconf(_SC_NPROCESSORS_ONLN) : 1;
+
+    chip_pool *pool = calloc(1, sizeof(chip_pool));
+
+    if (pool == 0)
+    {
+        fprintf(stderr, "Error while creating pool: out of memory\n");
+        return 0;
+    }
+
+    pool->threads = threads;
+    pool->worker = calloc(threads, sizeof(chip_worker));
+    pool->queue = aligned_alloc(64, threads * sizeof(chip_queue));
+
+    if (pool->worker == 0 || pool->queue == 0)
+    {
+        fprintf(stderr, "Error while creating pool: out of memory\n");
+        free(pool->worker);
+        free(pool->queue);
+        free(pool);
+        return 0;
+    }
+
+    pthread_mutex_init(&pool->lock, 0);
+    pthread_cond_init(&pool->start, 0);
+    pthread_cond_init(&pool->done, 0);
+
+    for (uint32 i = 0; i < threads; i++)
+    {
+        pthread_mutex_init(&pool->queue[i].lock, 0);
+        pool->worker[i].pool = pool;
+        pool->worker[i].index = i;
+
+        if (pin && cpus)
+        {
+            pool->worker[i].cpu = cpu[i % cpus];
+            pool->worker[i].node = pool_node(pool->worker[i].cpu);
+        }
+    }
+
+    for (uint32 i = 0; i < threads; i++)
+    {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+
+        if (pin && cpus)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(pool->worker[i].cpu, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+
+        int error = pthread_create(&pool->worker[i].thread, &attr, pool_main, &pool->worker[i]);
+        pthread_attr_destroy(&attr);
+
+        if (error)
+        {
+            fprintf(stderr, "Error while creating pool: cannot start worker %lu\n", i);
+            pool->threads = i;
+            util_pool_destroy(pool);
+            return 0;
+        }
+    }
+
+    return pool;
+}
+
+/**
+ * @brief Split [0, count) evenly between the workers, run the job and wait for it
+ *
+ * @param fixed 1 to keep every worker to its own slice
+ */
+static void pool_run(chip_pool *pool, uint32 count, chip_task task, void *arg, uint8 fixed)
+{
+    if (count == 0)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (uint32 i = 0; i < pool->threads; i++)
+    {
+        pthread_mutex_lock(&pool->queue[i].lock);
+        pool->queue[i].head = (uint64)count * i / pool->threads;
+        pool->queue[i].tail = (uint64)count * (i + 1) / pool->threads;
+        pthread_mutex_unlock(&pool->queue[i].lock);
+    }
+
+    pool->task = task;
+    pool->arg = arg;
+    pool->fixed = fixed;
+    pool->busy = pool->threads;
+    pool->job++;
+    pthread_cond_broadcast(&pool->start);
+
+    while (pool->busy > 0)
+        pthread_cond_wait(&pool->done, &pool->lock);
+
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * @brief Call task for every index in [0, count) on the pool and wait for all of them
+ *
+ * Indexes are split evenly between the workers; a worker that runs out steals
+ * half of the remaining indexes of another one, so uneven task lengths still
+ * keep every core busy.
+ *
+ * @param pool the pool to run on
+ * @param count number of indexes
+ * @param task the task body
+ * @param arg argument forwarded to every call
+ */
+void util_pool_run(chip_pool *pool, uint32 count, chip_task task, void *arg)
+{
+    pool_run(pool, count, task, arg, 0);
+}
+
+/**
+ * @brief Call task for every index in [0, count) on the pool, without stealing, and wait for all of them
+ *
+ * Worker i runs exactly the indexes [count * i / threads, count * (i + 1) / threads),
+ * the same on every call with the same count: data a pinned worker touches
+ * first for an index stays in its NUMA node, and it is the one using it.
+ *
+ * @param pool the pool to run on
+ * @param count number of indexes
+ * @param task the task body
+ * @param arg argument forwarded to every call
+ */
+void util_pool_run_fixed(chip_pool *pool, uint32 count, chip_task task, void *arg)
+{
+    pool_run(pool, count, task, arg, 1);
+}
+
+/**
+ * @brief Number of workers in the pool
+ */
+uint32 util_pool_threads(const chip_pool *pool)
+{
+    return pool->threads;
+}
+
+/**
+ * @brief NUMA node of a worker, 0 when the pool is not pinned
+ */
+uint32 util_pool_node(const chip_pool *pool, uint32 worker)
+{
+    return pool->worker[worker].node;
+}
+
+/**
+ * @brief Index of the calling worker, 0 outside of a pool
+ */
+uint32 util_pool_worker()
+{
+    return pool_worker;
+}
+
+/**
+ * @brief Stop the workers and free the pool
+ *
+ * @param pool the pool to destroy
+ */
+void util_pool_destroy(chip_pool *pool)
+{
+    if (pool == 0)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (uint32 i = 0; i < pool->threads; i++)
+        pthread_join(pool->worker[i].thread, 0);
+
+    free(pool->worker);
+    free(pool->queue);
+    free(pool);
+}
@@ -0,0 +1,478 @@
+#include <chip/chip.h>
+#include <chip/chip_quirks.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const chip_quirk_profile chip_quirk_profiles[] = {
+    {"cosmac", 0},
+    {"schip", CHIP_QUIRK_SHIFT | CHIP_QUIRK_MEMORY | CHIP_QUIRK_JUMP | CHIP_QUIRK_LOGIC},
+    {"xochip", CHIP_QUIRK_LOGIC | CHIP_QUIRK_WRAP},
+    {0, 0},
+};
+
+// frames between two samples of the display
+#define QUIRKS_SAMPLE 16
+
+// a detection: one trial for every combination of quirk bits
+typedef struct quirks_job
+{
+    const uint8 *rom;
+    uint32 size;
+    uint32 frames;
+    chip_quirk_trial trial[CHIP_QUIRKS + 1];
+} quirks_job;
+
+struct chip_quirk_cache
+{
+    char *file;
+    pthread_mutex_t lock;
+
+    // open addressing with linear probing, 0 marks an empty slot
+    uint64 *hash;
+    uint8 *quirks;
+    uint64 mask;
+    uint64 count;
+
+    // decisions added since the file was read
+    uint8 changed;
+};
+
+/**
+ * @brief Whether an opcode decodes to an instruction, SYS aside
+ */
+static uint8 quirks_valid(uint16 opcode)
+{
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        return opcode == 0x00E0 || opcode == 0x00EE;
+    case 0x5:
+    case 0x9:
+        return (opcode & 0xF) == 0;
+    case 0x8:
+        return (opcode & 0xF) <= 0x7 || (opcode & 0xF) == 0xE;
+    case 0xE:
+        return (opcode & 0xFF) == 0x9E || (opcode & 0xFF) == 0xA1;
+    case 0xF:
+        switch (opcode & 0xFF)
+        {
+        case 0x07:
+        case 0x0A:
+        case 0x15:
+        case 0x18:
+        case 0x1E:
+        case 0x29:
+        case 0x33:
+        case 0x55:
+        case 0x65:
+            return 1;
+        default:
+            return 0;
+        }
+    default:
+        return 1;
+    }
+}
+
+/**
+ * @brief Penalty of the instruction the running chip is about to execute
+ *
+ * Sane programs stay inside their own code, keep their stack balanced and
+ * draw sprites from the font or from their own data.
+ *
+ * @param size the length of the ROM
+ */
+static uint64 quirks_penalty(uint32 size)
+{
+    uint16 opcode = (chip->memory[chip->PC & 0xFFF] << 8) + chip->memory[(chip->PC & 0xFFF) + 1];
+
+    if (chip->PC < 0x200 || chip->PC >= 0x200 + size || !quirks_valid(opcode))
+        return 1;
+
+    if ((opcode == 0x00EE && chip->SP == 0) || ((opcode & 0xF000) == 0x2000 && chip->SP == 0xF))
+        return 1;
+
+    if ((opcode & 0xF000) == 0xD000 && chip->I >= 0x50 && chip->I < 0x200)
+        return 1;
+
+    return 0;
+}
+
+static int quirks_compare(const void *a, const void *b)
+{
+    uint64 x = *(const uint64 *)a, y = *(const uint64 *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Run the ROM under one combination of quirk bits and score it
+ *
+ * Inputs are scripted: every 20 frames the next key is held for 6 frames.
+ */
+static void quirks_trial(uint32 index, void *arg)
+{
+    quirks_job *job = arg;
+    chip_quirk_trial *trial = &job->trial[index];
+    chip_state *caller = chip, machine;
+    uint32 samples = 0;
+    uint64 *sample = malloc((job->frames / QUIRKS_SAMPLE + 1) * sizeof(uint64));
+
+    chip = &machine;
+    util_chip_init();
+    util_chip_load_ROM_bytes(job->rom, job->size);
+    chip->seed = util_chip_hash(job->rom, job->size);
+    chip->quirks = index;
+
+    *trial = (chip_quirk_trial){.quirks = index};
+
+    for (uint32 f = 0; f < job->frames; f++)
+    {
+        for (uint8 k = 0; k < 0x10; k++)
+            chip->key_state[k] = f % 20 < 6 && (f / 20) % 0x10 == k;
+
+        // util_chip_frame, scoring every instruction before it runs
+        if (chip->delay_timer > 0)
+            chip->delay_timer--;
+        if (chip->sound_timer > 0)
+            chip->sound_timer--;
+
+        for (uint8 i = 0; i < CHIP_FRAME_CYCLES; i++)
+        {
+            trial->penalty += quirks_penalty(job->size);
+            util_chip_cycle();
+        }
+
+        memcpy(chip->key_prev, chip->key_state, sizeof(chip->key_prev));
+
+        if (f % QUIRKS_SAMPLE == QUIRKS_SAMPLE - 1)
+        {
+            uint32 lit = 0;
+
+            for (uint32 p = 0; p < sizeof(chip->display); p++)
+                lit += ((uint8 *)chip->display)[p];
+
+            // a screen mostly lit is garbage drawn over and over
+            if (lit > sizeof(chip->display) / 4 * 3)
+                trial->penalty += QUIRKS_SAMPLE * CHIP_FRAME_CYCLES;
+
+            if (sample)
+                sample[samples++] = util_chip_hash(chip->display, sizeof(chip->display));
+        }
+    }
+
+    if (sample)
+    {
+        qsort(sample, samples, sizeof(uint64), quirks_compare);
+
+        for (uint32 s = 0; s < samples; s++)
+            trial->screens += s == 0 || sample[s] != sample[s - 1];
+
+        free(sample);
+    }
+
+    chip = caller;
+}
+
+/**
+ * @brief Guess the quirks a ROM was written for
+ *
+ * The ROM runs its first frames under every combination of quirk bits. The
+ * combination with the fewest signs of a broken program wins, then the one
+ * showing the most distinct screens, then the one with the fewest quirks:
+ * a ROM that behaves the same everywhere keeps the COSMAC behaviour.
+ *
+ * @param rom the ROM's bytes
+ * @param size the ROM's length
+ * @param frames frames every combination runs for
+ * @param pool threads to run the combinations on, 0 to run them on the caller
+ * @param trials receives the score of every combination, indexed by quirk bits, unless 0
+ * @return the chosen quirk bits
+ */
+uint8 util_quirks_detect(const uint8 *rom, uint32 size, uint32 frames, chip_pool *pool, chip_quirk_trial *trials)
+{
+    quirks_job job = {.rom = rom, .size = size, .frames = frames};
+
+    if (job.size > CHIP_MEMORY_SIZE - 0x200)
+        job.size = CHIP_MEMORY_SIZE - 0x200;
+
+    if (pool)
+        util_pool_run(pool, CHIP_QUIRKS + 1, quirks_trial, &job);
+    else
+        for (uint32 q = 0; q <= CHIP_QUIRKS; q++)
+            quirks_trial(q, &job);
+
+    chip_quirk_trial *best = &job.trial[0];
+
+    for (uint32 q = 1; q <= CHIP_QUIRKS; q++)
+    {
+        chip_quirk_trial *trial = &job.trial[q];
+
+        if (trial->penalty != best->penalty)
+        {
+            if (trial->penalty < best->penalty)
+                best = trial;
+        }
+        else if (trial->screens != best->screens)
+        {
+            if (trial->screens > best->screens)
+                best = trial;
+        }
+        else if (__builtin_popcount(trial->quirks) < __builtin_popcount(best->quirks))
+            best = trial;
+    }
+
+    if (trials)
+        memcpy(trials, job.trial, sizeof(job.trial));
+
+    return best->quirks;
+}
+
+/**
+ * @brief Read quirk bits from a profile name or a hexadecimal number
+ *
+ * @param text the profile name, e.g. schip, or the bits, e.g. 0x0F
+ * @param quirks receives the quirk bits
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 util_quirks_parse(const char *text, uint8 *quirks)
+{
+    for (const chip_quirk_profile *profile = chip_quirk_profiles; profile->name; profile++)
+        if (strcmp(text, profile->name) == 0)
+        {
+            *quirks = profile->quirks;
+            return 0;
+        }
+
+    char *end;
+    unsigned long bits = strtoul(text, &end, 16);
+
+    if (*text == 0 || *end || bits > CHIP_QUIRKS)
+    {
+        fprintf(stderr, "Error while reading quirks: unknown profile %s\n", text);
+        return 1;
+    }
+
+    *quirks = bits;
+    return 0;
+}
+
+/**
+ * @brief Name of the profile with exactly these quirk bits
+ *
+ * @return the profile's name, 0 if no profile matches
+ */
+const char *util_quirks_name(uint8 quirks)
+{
+    for (const chip_quirk_profile *profile = chip_quirk_profiles; profile->name; profile++)
+        if (profile->quirks == quirks)
+            return profile->name;
+
+    return 0;
+}
+
+/**
+ * @brief Store a decision, the table being locked and having room
+ *
+ * @return 1 if the decision is new, 0 if the table already held it
+ */
+static uint8 quirk_cache_insert(chip_quirk_cache *cache, uint64 hash, uint8 quirks)
+{
+    // 0 marks an empty slot
+    if (hash == 0)
+        hash = 1;
+
+    uint64 i = hash & cache->mask;
+
+    while (cache->hash[i] && cache->hash[i] != hash)
+        i = (i + 1) & cache->mask;
+
+    if (cache->hash[i] == hash && cache->quirks[i] == quirks)
+        return 0;
+
+    cache->count += cache->hash[i] == 0;
+    cache->hash[i] = hash;
+    cache->quirks[i] = quirks;
+
+    return 1;
+}
+
+/**
+ * @brief Double the table once it is 3/4 full, the table being locked
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+static uint8 quirk_cache_grow(chip_quirk_cache *cache)
+{
+    if (cache->hash && cache->count < (cache->mask + 1) / 4 * 3)
+        return 0;
+
+    uint64 size = cache->hash ? (cache->mask + 1) * 2 : 1024;
+    uint64 *hash = calloc(size, sizeof(uint64));
+    uint8 *quirks = calloc(size, 1);
+
+    if (hash == 0 || quirks == 0)
+    {
+        fprintf(stderr, "Error while growing quirk cache: out of memory\n");
+        free(hash);
+        free(quirks);
+        return 1;
+    }
+
+    uint64 *old_hash = cache->hash;
+    uint8 *old_quirks = cache->quirks;
+    uint64 old_size = old_hash ? cache->mask + 1 : 0;
+
+    cache->hash = hash;
+    cache->quirks = quirks;
+    cache->mask = size - 1;
+    cache->count = 0;
+
+    for (uint64 i = 0; i < old_size; i++)
+        if (old_hash[i])
+            quirk_cache_insert(cache, old_hash[i], old_quirks[i]);
+
+    free(old_hash);
+    free(old_quirks);
+
+    return 0;
+}
+
+/**
+ * @brief Open the decisions kept in a file, one "hash quirks" line per ROM
+ *
+ * A missing file is an empty cache; it is written by util_quirk_cache_close.
+ *
+ * @param fileName the cache file
+ * @return the cache, 0 if error occurred
+ */
+chip_quirk_cache *util_quirk_cache_open(const char *fileName)
+{
+    chip_quirk_cache *cache = calloc(1, sizeof(chip_quirk_cache));
+
+    if (cache == 0 || (cache->file = strdup(fileName)) == 0)
+    {
+        fprintf(stderr, "Error while opening quirk cache: out of memory\n");
+        free(cache);
+        return 0;
+    }
+
+    pthread_mutex_init(&cache->lock, 0);
+
+    if (quirk_cache_grow(cache))
+    {
+        util_quirk_cache_close(cache);
+        return 0;
+    }
+
+    FILE *file = fopen(fileName, "r");
+
+    if (file == 0)
+        return cache;
+
+    unsigned long long hash;
+    unsigned int quirks;
+
+    while (fscanf(file, "%llx %x", &hash, &quirks) == 2)
+    {
+        if (quirk_cache_grow(cache))
+        {
+            fclose(file);
+            util_quirk_cache_close(cache);
+            return 0;
+        }
+
+        quirk_cache_insert(cache, hash, quirks & CHIP_QUIRKS);
+    }
+
+    fclose(file);
+
+    return cache;
+}
+
+/**
+ * @brief Look up the decision taken for a ROM, from any thread
+ *
+ * @param hash the hash of the ROM's bytes
+ * @param quirks receives the quirk bits
+ * @return 1 if the ROM is in the cache, 0 otherwise
+ */
+uint8 util_quirk_cache_get(chip_quirk_cache *cache, uint64 hash, uint8 *quirks)
+{
+    if (hash == 0)
+        hash = 1;
+
+    pthread_mutex_lock(&cache->lock);
+
+    uint64 i = hash & cache->mask;
+
+    while (cache->hash[i] && cache->hash[i] != hash)
+        i = (i + 1) & cache->mask;
+
+    uint8 found = cache->hash[i] == hash;
+
+    if (found)
+        *quirks = cache->quirks[i];
+
+    pthread_mutex_unlock(&cache->lock);
+
+    return found;
+}
+
+/**
+ * @brief Keep the decision taken for a ROM, from any thread
+ *
+ * A decision that cannot be kept for lack of memory is only lost from the cache.
+ *
+ * @param hash the hash of the ROM's bytes
+ * @param quirks the quirk bits
+ */
+void util_quirk_cache_put(chip_quirk_cache *cache, uint64 hash, uint8 quirks)
+{
+    pthread_mutex_lock(&cache->lock);
+
+    if (quirk_cache_grow(cache) == 0 && quirk_cache_insert(cache, hash, quirks))
+        cache->changed = 1;
+
+    pthread_mutex_unlock(&cache->lock);
+}
+
+/**
+ * @brief Write the cache back to its file if it changed, and free it
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 util_quirk_cache_close(chip_quirk_cache *cache)
+{
+    uint8 error = 0;
+
+    if (cache->changed)
+    {
+        FILE *file = fopen(cache->file, "w");
+
+        if (file == 0)
+        {
+            perror("Failed to write quirk cache.\n");
+            error = 1;
+        }
+        else
+        {
+            for (uint64 i = 0; i <= cache->mask; i++)
+                if (cache->hash[i])
+                    fprintf(file, "%016llx %02x\n", cache->hash[i], cache->quirks[i]);
+
+            error = fclose(file) != 0;
+        }
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->file);
+    free(cache->hash);
+    free(cache->quirks);
+    free(cache);
+
+    return error;
+}
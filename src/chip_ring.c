@@ -0,0 +1,82 @@
+#include <chip/chip_ring.h>
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/**
+ * @brief Map a ring shared with every process forked afterwards
+ *
+ * @param slots number of records the ring holds
+ * @param size bytes of every record
+ * @return the ring, 0 if error occurred
+ */
+chip_ring *util_ring_create(uint32 slots, uint32 size)
+{
+    chip_ring *ring = mmap(0, sizeof(chip_ring) + (uint64)slots * size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if (ring == MAP_FAILED)
+    {
+        fprintf(stderr, "Error while creating ring: out of memory\n");
+        return 0;
+    }
+
+    ring->slots = slots;
+    ring->size = size;
+
+    return ring;
+}
+
+/**
+ * @brief Copy a record into the ring, from the producer
+ *
+ * @return 1 if the ring is full, 0 otherwise
+ */
+uint8 util_ring_push(chip_ring *ring, const void *record)
+{
+    uint64 tail = ring->tail;
+
+    if (tail - __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->slots)
+        return 1;
+
+    memcpy(ring->data + (tail % ring->slots) * ring->size, record, ring->size);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief Copy the oldest record out of the ring, from the consumer
+ *
+ * @return 1 if the ring is empty, 0 otherwise
+ */
+uint8 util_ring_pop(chip_ring *ring, void *record)
+{
+    uint64 head = ring->head;
+
+    if (head == __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+        return 1;
+
+    memcpy(record, ring->data + (head % ring->slots) * ring->size, ring->size);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    return 0;
+}
+
+/**
+ * @brief Empty the ring; neither side may be using it
+ */
+void util_ring_reset(chip_ring *ring)
+{
+    ring->head = 0;
+    ring->tail = 0;
+}
+
+/**
+ * @brief Unmap a ring
+ */
+void util_ring_destroy(chip_ring *ring)
+{
+    if (ring)
+        munmap(ring, sizeof(chip_ring) + (uint64)ring->slots * ring->size);
+}
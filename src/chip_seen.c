@@ -0,0 +1,86 @@
+#include <chip/chip_seen.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * @brief Allocate a set for at least capacity hashes
+ *
+ * @param capacity the number of hashes to hold
+ * @return the set, 0 if error occurred
+ */
+chip_seen *util_seen_create(uint64 capacity)
+{
+    chip_seen *seen = calloc(1, sizeof(chip_seen));
+
+    // keep the table at most 3/4 full
+    uint64 size = 1024;
+    while (size / 4 * 3 < capacity)
+        size <<= 1;
+
+    if (seen == 0 || (seen->slot = calloc(size, sizeof(uint64))) == 0)
+    {
+        fprintf(stderr, "Error while creating state table: out of memory\n");
+        free(seen);
+        return 0;
+    }
+
+    seen->mask = size - 1;
+
+    return seen;
+}
+
+/**
+ * @brief Add a hash to the set, from any thread
+ *
+ * @param seen the set
+ * @param hash the hash to add
+ * @return 1 if the hash is new, 0 if it was already there or the set is full
+ */
+uint8 util_seen_insert(chip_seen *seen, uint64 hash)
+{
+    // 0 marks an empty slot
+    if (hash == 0)
+        hash = 1;
+
+    if (__atomic_load_n(&seen->count, __ATOMIC_RELAXED) >= (seen->mask + 1) / 4 * 3)
+    {
+        __atomic_store_n(&seen->full, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    for (uint64 i = hash & seen->mask;; i = (i + 1) & seen->mask)
+    {
+        uint64 slot = __atomic_load_n(&seen->slot[i], __ATOMIC_RELAXED);
+
+        if (slot == hash)
+            return 0;
+
+        if (slot == 0)
+        {
+            uint64 empty = 0;
+
+            if (__atomic_compare_exchange_n(&seen->slot[i], &empty, hash, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                __atomic_add_fetch(&seen->count, 1, __ATOMIC_RELAXED);
+                return 1;
+            }
+
+            // another thread took the slot: it may have stored the same hash
+            if (empty == hash)
+                return 0;
+        }
+    }
+}
+
+/**
+ * @brief Free a set
+ */
+void util_seen_destroy(chip_seen *seen)
+{
+    if (seen == 0)
+        return;
+
+    free(seen->slot);
+    free(seen);
+}
@@ -0,0 +1,378 @@
+#include <chip/chip_sink.h>
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// rows of one worker, filled column by column
+typedef struct chip_sink_buffer
+{
+    struct chip_sink_buffer *next;
+    uint32 rows;
+
+    // per column: CHIP_SINK_ROWS values, or the text end offsets
+    uint8 **column;
+
+    // per text column: the rows' text back to back
+    char **text;
+    uint64 *text_used;
+    uint64 *text_size;
+} chip_sink_buffer;
+
+struct chip_sink
+{
+    FILE *file;
+    chip_sink_column *column;
+    uint8 columns;
+
+    // buffer being filled by each worker
+    chip_sink_buffer **active;
+    uint32 threads;
+
+    // buffers waiting for the writer, and buffers ready to be filled
+    chip_sink_buffer *full;
+    chip_sink_buffer *free;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_cond_t freed;
+    pthread_t writer;
+    uint8 started;
+    uint8 closing;
+    uint8 error;
+};
+
+static void sink_buffer_free(const chip_sink *sink, chip_sink_buffer *buffer)
+{
+    if (buffer == 0)
+        return;
+
+    for (uint8 c = 0; c < sink->columns; c++)
+    {
+        if (buffer->column)
+            free(buffer->column[c]);
+        if (buffer->text)
+            free(buffer->text[c]);
+    }
+
+    free(buffer->column);
+    free(buffer->text);
+    free(buffer->text_used);
+    free(buffer->text_size);
+    free(buffer);
+}
+
+static chip_sink_buffer *sink_buffer_create(const chip_sink *sink)
+{
+    chip_sink_buffer *buffer = calloc(1, sizeof(chip_sink_buffer));
+
+    if (buffer == 0)
+        return 0;
+
+    buffer->column = calloc(sink->columns, sizeof(uint8 *));
+    buffer->text = calloc(sink->columns, sizeof(char *));
+    buffer->text_used = calloc(sink->columns, sizeof(uint64));
+    buffer->text_size = calloc(sink->columns, sizeof(uint64));
+
+    if (buffer->column == 0 || buffer->text == 0 || buffer->text_used == 0 || buffer->text_size == 0)
+    {
+        sink_buffer_free(sink, buffer);
+        return 0;
+    }
+
+    for (uint8 c = 0; c < sink->columns; c++)
+    {
+        uint64 width = sink->column[c].type == CHIP_SINK_U8 ? 1 : 8;
+
+        if ((buffer->column[c] = malloc(CHIP_SINK_ROWS * width)) == 0)
+        {
+            sink_buffer_free(sink, buffer);
+            return 0;
+        }
+    }
+
+    return buffer;
+}
+
+/**
+ * @brief Append a buffer to the file as one block, on the writer thread
+ */
+static void sink_write(chip_sink *sink, const chip_sink_buffer *buffer)
+{
+    uint64 rows = buffer->rows;
+    uint8 error = fwrite(CHIP_SINK_BLOCK, 4, 1, sink->file) != 1 || fwrite(&rows, 8, 1, sink->file) != 1;
+
+    for (uint8 c = 0; c < sink->columns && !error; c++)
+    {
+        uint64 width = sink->column[c].type == CHIP_SINK_U8 ? 1 : 8;
+        uint64 text = sink->column[c].type == CHIP_SINK_TEXT ? buffer->text_used[c] : 0;
+        uint64 length = rows * width + text;
+
+        error = fwrite(&length, 8, 1, sink->file) != 1 || fwrite(buffer->column[c], width, rows, sink->file) != rows ||
+                (text && fwrite(buffer->text[c], text, 1, sink->file) != 1);
+    }
+
+    if (error)
+        sink->error = 1;
+}
+
+static void *sink_main(void *data)
+{
+    chip_sink *sink = data;
+
+    pthread_mutex_lock(&sink->lock);
+
+    for (;;)
+    {
+        while (sink->full == 0 && !sink->closing)
+            pthread_cond_wait(&sink->wake, &sink->lock);
+
+        chip_sink_buffer *buffer = sink->full;
+
+        if (buffer == 0)
+            break;
+
+        sink->full = buffer->next;
+        pthread_mutex_unlock(&sink->lock);
+
+        sink_write(sink, buffer);
+
+        buffer->rows = 0;
+        for (uint8 c = 0; c < sink->columns; c++)
+            buffer->text_used[c] = 0;
+
+        pthread_mutex_lock(&sink->lock);
+        buffer->next = sink->free;
+        sink->free = buffer;
+        pthread_cond_signal(&sink->freed);
+    }
+
+    pthread_mutex_unlock(&sink->lock);
+    return 0;
+}
+
+/**
+ * @brief Hand a worker's buffer to the writer and take an empty one
+ *
+ * Blocks while the writer is behind on every spare buffer.
+ */
+static void sink_submit(chip_sink *sink, uint32 worker)
+{
+    pthread_mutex_lock(&sink->lock);
+
+    chip_sink_buffer *buffer = sink->active[worker];
+    buffer->next = sink->full;
+    sink->full = buffer;
+    pthread_cond_signal(&sink->wake);
+
+    while (sink->free == 0)
+        pthread_cond_wait(&sink->freed, &sink->lock);
+
+    sink->active[worker] = sink->free;
+    sink->free = sink->free->next;
+
+    pthread_mutex_unlock(&sink->lock);
+}
+
+/**
+ * @brief Create a result file and start its writer thread
+ *
+ * Every worker fills its own buffer without locking; full buffers are written
+ * by a background thread while the worker keeps going on a spare one.
+ *
+ * @param fileName the file to create
+ * @param column the columns of every row
+ * @param columns number of columns
+ * @param threads number of workers appending rows, indexed from 0
+ * @return the sink, 0 if error occurred
+ */
+chip_sink *util_sink_create(const char *fileName, const chip_sink_column *column, uint8 columns, uint32 threads)
+{
+    chip_sink *sink = calloc(1, sizeof(chip_sink));
+
+    if (sink == 0 || (sink->column = malloc(columns * sizeof(chip_sink_column))) == 0 ||
+        (sink->active = calloc(threads, sizeof(chip_sink_buffer *))) == 0)
+    {
+        fprintf(stderr, "Error while creating result file: out of memory\n");
+        if (sink)
+            free(sink->column);
+        free(sink);
+        return 0;
+    }
+
+    memcpy(sink->column, column, columns * sizeof(chip_sink_column));
+    sink->columns = columns;
+    sink->threads = threads;
+
+    // one buffer per worker plus one spare each, so workers rarely wait on the writer
+    for (uint32 i = 0; i < threads * 2; i++)
+    {
+        chip_sink_buffer *buffer = sink_buffer_create(sink);
+
+        if (buffer == 0)
+        {
+            fprintf(stderr, "Error while creating result file: out of memory\n");
+            util_sink_close(sink);
+            return 0;
+        }
+
+        if (i < threads)
+            sink->active[i] = buffer;
+        else
+        {
+            buffer->next = sink->free;
+            sink->free = buffer;
+        }
+    }
+
+    sink->file = fopen(fileName, "wb");
+
+    if (sink->file == 0)
+    {
+        perror("Failed to create result file.\n");
+        util_sink_close(sink);
+        return 0;
+    }
+
+    uint64 order = CHIP_SINK_ORDER, count = columns;
+    fwrite(CHIP_SINK_MAGIC, 4, 1, sink->file);
+    fwrite(&order, 8, 1, sink->file);
+    fwrite(&count, 8, 1, sink->file);
+
+    for (uint8 c = 0; c < columns; c++)
+    {
+        uint8 length = strlen(column[c].name);
+
+        fwrite(&column[c].type, 1, 1, sink->file);
+        fwrite(&length, 1, 1, sink->file);
+        fwrite(column[c].name, length, 1, sink->file);
+    }
+
+    pthread_mutex_init(&sink->lock, 0);
+    pthread_cond_init(&sink->wake, 0);
+    pthread_cond_init(&sink->freed, 0);
+
+    if (pthread_create(&sink->writer, 0, sink_main, sink))
+    {
+        fprintf(stderr, "Error while creating result file: cannot start writer\n");
+        util_sink_close(sink);
+        return 0;
+    }
+
+    sink->started = 1;
+    return sink;
+}
+
+/**
+ * @brief Append a row from a worker
+ *
+ * @param sink the result file
+ * @param worker the calling worker, e.g. util_pool_worker()
+ * @param row one value per column
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 util_sink_append(chip_sink *sink, uint32 worker, const chip_sink_value *row)
+{
+    chip_sink_buffer *buffer = sink->active[worker];
+    uint32 r = buffer->rows;
+
+    for (uint8 c = 0; c < sink->columns; c++)
+    {
+        switch (sink->column[c].type)
+        {
+        case CHIP_SINK_U8:
+            buffer->column[c][r] = row[c].number;
+            break;
+        case CHIP_SINK_U64:
+            ((uint64 *)buffer->column[c])[r] = row[c].number;
+            break;
+        case CHIP_SINK_TEXT:
+        {
+            uint64 length = strlen(row[c].text);
+
+            if (buffer->text_used[c] + length > buffer->text_size[c])
+            {
+                uint64 size = buffer->text_size[c] ? buffer->text_size[c] * 2 : 0x10000;
+                while (size < buffer->text_used[c] + length)
+                    size *= 2;
+
+                char *grown = realloc(buffer->text[c], size);
+
+                if (grown == 0)
+                {
+                    fprintf(stderr, "Error while writing result file: out of memory\n");
+                    return 1;
+                }
+
+                buffer->text[c] = grown;
+                buffer->text_size[c] = size;
+            }
+
+            memcpy(buffer->text[c] + buffer->text_used[c], row[c].text, length);
+            buffer->text_used[c] += length;
+            ((uint64 *)buffer->column[c])[r] = buffer->text_used[c];
+            break;
+        }
+        }
+    }
+
+    if (++buffer->rows == CHIP_SINK_ROWS)
+        sink_submit(sink, worker);
+
+    return 0;
+}
+
+/**
+ * @brief Write the rows still buffered, stop the writer and close the file
+ *
+ * No worker may append while the sink closes.
+ *
+ * @param sink the result file
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 util_sink_close(chip_sink *sink)
+{
+    if (sink->started)
+    {
+        pthread_mutex_lock(&sink->lock);
+
+        for (uint32 i = 0; i < sink->threads; i++)
+            if (sink->active[i]->rows)
+            {
+                sink->active[i]->next = sink->full;
+                sink->full = sink->active[i];
+                sink->active[i] = 0;
+            }
+
+        sink->closing = 1;
+        pthread_cond_signal(&sink->wake);
+        pthread_mutex_unlock(&sink->lock);
+
+        pthread_join(sink->writer, 0);
+    }
+
+    if (sink->file && fclose(sink->file))
+        sink->error = 1;
+
+    uint8 error = sink->error;
+
+    if (error)
+        fprintf(stderr, "Error while writing result file: write failed\n");
+
+    for (uint32 i = 0; i < sink->threads; i++)
+        sink_buffer_free(sink, sink->active[i]);
+
+    while (sink->free)
+    {
+        chip_sink_buffer *next = sink->free->next;
+        sink_buffer_free(sink, sink->free);
+        sink->free = next;
+    }
+
+    free(sink->active);
+    free(sink->column);
+    free(sink);
+
+    return error;
+}
@@ -0,0 +1,204 @@
+#include <chip/chip.h>
+#include <chip/chip_tailcall.h>
+
+// a handler runs the instruction opcode at pc, then hands the next one to its own handler
+typedef uint16 (*tail_handler)(chip_state *, uint16, uint16, uint32);
+
+static const tail_handler tail_table[0x10];
+
+#define TAIL_X ((opcode >> 8) & 0xF)
+#define TAIL_Y ((opcode >> 4) & 0xF)
+#define TAIL_KK (opcode & 0xFF)
+#define TAIL_NNN (opcode & 0xFFF)
+
+/**
+ * @brief Fetch the instruction at pc and go to its handler
+ *
+ * @param left the instructions still to run
+ * @return the PC the run stops at, once none are left
+ */
+static inline uint16 tail_next(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    if (left == 0)
+        return pc;
+
+    uint16 at = pc & 0xFFF;
+    opcode = c->memory[at] << 8 | c->memory[at + 1];
+
+    CHIP_MUSTTAIL return tail_table[opcode >> 12](c, pc, opcode, left - 1);
+}
+
+static uint16 tail_0(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    if (opcode == 0x00E0)
+    {
+        CLS();
+        pc += 2;
+    }
+    else if (opcode == 0x00EE)
+    {
+        pc = c->stack[c->SP];
+        c->SP = (c->SP - 1) & 0xF;
+    }
+    else
+        pc = TAIL_NNN;
+
+    CHIP_MUSTTAIL return tail_next(c, pc, opcode, left);
+}
+
+static uint16 tail_jp(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    (void)pc;
+
+    CHIP_MUSTTAIL return tail_next(c, TAIL_NNN, opcode, left);
+}
+
+static uint16 tail_call(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    c->SP = (c->SP + 1) & 0xF;
+    c->stack[c->SP] = pc + 2;
+
+    CHIP_MUSTTAIL return tail_next(c, TAIL_NNN, opcode, left);
+}
+
+static uint16 tail_se(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    CHIP_MUSTTAIL return tail_next(c, pc + (c->V[TAIL_X] == TAIL_KK ? 4 : 2), opcode, left);
+}
+
+static uint16 tail_sne(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    CHIP_MUSTTAIL return tail_next(c, pc + (c->V[TAIL_X] != TAIL_KK ? 4 : 2), opcode, left);
+}
+
+static uint16 tail_se2(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    CHIP_MUSTTAIL return tail_next(c, pc + ((opcode & 0xF) == 0 && c->V[TAIL_X] == c->V[TAIL_Y] ? 4 : 2), opcode, left);
+}
+
+static uint16 tail_ld(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    c->V[TAIL_X] = TAIL_KK;
+
+    CHIP_MUSTTAIL return tail_next(c, pc + 2, opcode, left);
+}
+
+static uint16 tail_add(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    c->V[TAIL_X] += TAIL_KK;
+
+    CHIP_MUSTTAIL return tail_next(c, pc + 2, opcode, left);
+}
+
+static uint16 tail_alu(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    static void (*const alu[0x10])(uint8, uint8) = {LD2, OR, AND, XOR, ADD2, SUB, SHR, SUBN, [0xE] = SHL};
+
+    if (alu[opcode & 0xF])
+        alu[opcode & 0xF](TAIL_X, TAIL_Y);
+
+    CHIP_MUSTTAIL return tail_next(c, pc + 2, opcode, left);
+}
+
+static uint16 tail_sne2(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    CHIP_MUSTTAIL return tail_next(c, pc + ((opcode & 0xF) == 0 && c->V[TAIL_X] != c->V[TAIL_Y] ? 4 : 2), opcode, left);
+}
+
+static uint16 tail_ldi(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    c->I = TAIL_NNN;
+
+    CHIP_MUSTTAIL return tail_next(c, pc + 2, opcode, left);
+}
+
+static uint16 tail_jp2(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    pc = TAIL_NNN + c->V[c->quirks & CHIP_QUIRK_JUMP ? TAIL_X : 0x0];
+
+    CHIP_MUSTTAIL return tail_next(c, pc, opcode, left);
+}
+
+static uint16 tail_rnd(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    RND(TAIL_X, TAIL_KK);
+
+    CHIP_MUSTTAIL return tail_next(c, pc + 2, opcode, left);
+}
+
+static uint16 tail_drw(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    DRW(TAIL_X, TAIL_Y, opcode & 0xF);
+
+    CHIP_MUSTTAIL return tail_next(c, pc + 2, opcode, left);
+}
+
+static uint16 tail_key(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    uint8 pressed = c->key_state[c->V[TAIL_X] & 0xF];
+
+    if ((TAIL_KK == 0x9E && pressed) || (TAIL_KK == 0xA1 && !pressed))
+        pc += 2;
+
+    CHIP_MUSTTAIL return tail_next(c, pc + 2, opcode, left);
+}
+
+static uint16 tail_f(chip_state *c, uint16 pc, uint16 opcode, uint32 left)
+{
+    static void (*const fx[0x100])(uint8) = {[0x07] = LD4,  [0x15] = LDDT, [0x18] = LDST, [0x1E] = ADDI,
+                                             [0x29] = LDF,  [0x33] = LDB,  [0x55] = LDI,  [0x65] = LD6};
+    pc += 2;
+
+    // Fx0A moves PC back onto itself while no key is pressed
+    if (TAIL_KK == 0x0A)
+    {
+        c->PC = pc;
+        LD5(TAIL_X);
+        pc = c->PC;
+    }
+    else if (fx[TAIL_KK])
+        fx[TAIL_KK](TAIL_X);
+
+    CHIP_MUSTTAIL return tail_next(c, pc, opcode, left);
+}
+
+static const tail_handler tail_table[0x10] = {tail_0,    tail_jp,  tail_call, tail_se,  tail_sne, tail_se2, tail_ld,  tail_add,
+                                              tail_alu,  tail_sne2, tail_ldi, tail_jp2, tail_rnd, tail_drw, tail_key, tail_f};
+
+/**
+ * @brief Run the running chip for a number of instructions, the same as that many util_chip_cycle calls
+ *
+ * Every handler ends by calling the handler of the next instruction, PC and
+ * the instructions left travelling in arguments rather than through memory:
+ * with the calls turned into jumps, dispatch is one indirect jump per
+ * instruction, from the handler that ran. Without a guaranteed tail call
+ * (CHIP_MUSTTAIL) this relies on the optimizer, and the stack grows with
+ * the instructions run when it is off.
+ *
+ * @param cycles the instructions to run
+ */
+void util_tailcall_run(uint32 cycles)
+{
+    chip->PC = tail_next(chip, chip->PC, 0, cycles);
+    chip->cycles += cycles;
+}
+
+/**
+ * @brief The same as util_chip_frame, on the tail-call interpreter
+ */
+void util_tailcall_frame()
+{
+    if (chip->delay_timer > 0)
+        chip->delay_timer--;
+
+    if (chip->sound_timer > 0)
+        chip->sound_timer--;
+
+    if (util_chip_suspended())
+        chip->cycles += CHIP_FRAME_CYCLES;
+    else
+        util_tailcall_run(CHIP_FRAME_CYCLES);
+
+    for (uint8 i = 0; i < 0x10; i++)
+        chip->key_prev[i] = chip->key_state[i];
+}
@@ -0,0 +1,643 @@
+#include <chip/chip.h>
+#include <chip/chip_analysis.h>
+#include <chip/chip_tier.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// what a predecoded instruction runs: simple instructions and the usual block exits run inline
+enum tier_kind
+{
+    TIER_NOP,
+    TIER_EXIT,
+    TIER_JP,
+    TIER_CALL,
+    TIER_SE,
+    TIER_SNE,
+    TIER_SE2,
+    TIER_SNE2,
+    TIER_SKP,
+    TIER_SKNP,
+    TIER_CLS,
+    TIER_LD,
+    TIER_ADD,
+    TIER_LD2,
+    TIER_OR,
+    TIER_AND,
+    TIER_XOR,
+    TIER_ADD2,
+    TIER_SUB,
+    TIER_SHR,
+    TIER_SUBN,
+    TIER_SHL,
+    TIER_LD3,
+    TIER_RND,
+    TIER_DRW,
+    TIER_LD4,
+    TIER_LDDT,
+    TIER_LDST,
+    TIER_ADDI,
+    TIER_LDF,
+    TIER_LDB,
+    TIER_LDI,
+    TIER_LD6,
+};
+
+// pairs of instructions run in one dispatch (superinstructions)
+enum tier_fused
+{
+    TIER_SINGLE,
+    TIER_LD_LD,
+    TIER_LD3_DRW,
+    TIER_LD3_LD6,
+    TIER_ADD_SE,
+    TIER_ADD_SNE,
+};
+
+/**
+ * @brief Decode an instruction, the same as util_chip_execute
+ *
+ * Block exits not run inline (RET, SYS, Bnnn, Fx0A) go back to util_chip_execute.
+ */
+static void tier_decode(chip_op *op, uint16 opcode)
+{
+    static const uint8 alu[0x10] = {TIER_LD2, TIER_OR, TIER_AND, TIER_XOR, TIER_ADD2, TIER_SUB, TIER_SHR, TIER_SUBN, [0xE] = TIER_SHL};
+    static const uint8 fx[0x100] = {[0x07] = TIER_LD4,  [0x0A] = TIER_EXIT, [0x15] = TIER_LDDT, [0x18] = TIER_LDST, [0x1E] = TIER_ADDI,
+                                    [0x29] = TIER_LDF,  [0x33] = TIER_LDB,  [0x55] = TIER_LDI,  [0x65] = TIER_LD6};
+    uint8 kk = opcode & 0xFF;
+
+    *op = (chip_op){.x = (opcode >> 8) & 0xF, .y = (opcode >> 4) & 0xF, .n = opcode & 0xF, .nnn = opcode & 0xFFF, .opcode = opcode};
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        op->kind = opcode == 0x00E0 ? TIER_CLS : TIER_EXIT;
+        return;
+    case 0x1:
+        op->kind = TIER_JP;
+        return;
+    case 0x2:
+        op->kind = TIER_CALL;
+        return;
+    case 0x3:
+        op->kind = TIER_SE, op->nnn = kk;
+        return;
+    case 0x4:
+        op->kind = TIER_SNE, op->nnn = kk;
+        return;
+    case 0x5:
+        op->kind = op->n == 0 ? TIER_SE2 : TIER_NOP;
+        return;
+    case 0x6:
+        op->kind = TIER_LD, op->nnn = kk;
+        return;
+    case 0x7:
+        op->kind = TIER_ADD, op->nnn = kk;
+        return;
+    case 0x8:
+        op->kind = alu[op->n];
+        return;
+    case 0x9:
+        op->kind = op->n == 0 ? TIER_SNE2 : TIER_NOP;
+        return;
+    case 0xA:
+        op->kind = TIER_LD3;
+        return;
+    case 0xB:
+        op->kind = TIER_EXIT;
+        return;
+    case 0xC:
+        op->kind = TIER_RND, op->nnn = kk;
+        return;
+    case 0xD:
+        op->kind = TIER_DRW;
+        return;
+    case 0xE:
+        op->kind = kk == 0x9E ? TIER_SKP : kk == 0xA1 ? TIER_SKNP : TIER_NOP;
+        return;
+    default:
+        op->kind = fx[kk];
+        return;
+    }
+}
+
+/**
+ * @brief Mark the pairs of a block that run as one superinstruction
+ *
+ * Loading two registers (6xkk 6ykk), pointing I at a sprite or a table and
+ * using it (Annn Dxyn, Annn Fx65) and stepping a loop counter then testing it
+ * (7xkk 3xkk, 7xkk 4xkk) make up most of the pairs in typical ROMs.
+ */
+static void tier_fuse(chip_block *block)
+{
+    for (uint8 i = 0; i + 1 < block->length; i++)
+    {
+        chip_op *op = &block->op[i], *next = op + 1;
+
+        if (op->kind == TIER_LD && next->kind == TIER_LD)
+            op->fused = TIER_LD_LD;
+        else if (op->kind == TIER_LD3 && next->kind == TIER_DRW)
+            op->fused = TIER_LD3_DRW;
+        else if (op->kind == TIER_LD3 && next->kind == TIER_LD6)
+            op->fused = TIER_LD3_LD6;
+        else if (op->kind == TIER_ADD && next->kind == TIER_SE && op->x == next->x)
+            op->fused = TIER_ADD_SE;
+        else if (op->kind == TIER_ADD && next->kind == TIER_SNE && op->x == next->x)
+            op->fused = TIER_ADD_SNE;
+        else
+            continue;
+
+        // pairs do not overlap
+        i++;
+    }
+}
+
+/**
+ * @brief Predecode the block of the ROM starting at start and publish it
+ *
+ * Addresses outside the ROM stay interpreted.
+ */
+static void tier_compile(chip_tier *tier, uint16 start)
+{
+    if (start < 0x200 || (uint32)start + 2 > 0x200 + tier->size)
+        return;
+
+    chip_block *block = calloc(1, sizeof(chip_block));
+
+    if (block == 0)
+    {
+        fprintf(stderr, "Error while compiling block: out of memory\n");
+        return;
+    }
+
+    block->start = start;
+
+    for (uint16 addr = start; block->length < CHIP_BLOCK_MAX && (uint32)addr + 2 <= 0x200 + tier->size; addr += 2)
+    {
+        uint16 opcode = tier->rom[addr - 0x200] << 8 | tier->rom[addr - 0x200 + 1];
+
+        memcpy(block->bytes + 2 * block->length, tier->rom + addr - 0x200, 2);
+        tier_decode(&block->op[block->length++], opcode);
+
+        if (util_analysis_ends(opcode))
+            break;
+    }
+
+    tier_fuse(block);
+
+    for (uint8 i = 0; i < 8 && i < 2 * block->length; i++)
+    {
+        block->head |= (uint64)block->bytes[i] << 8 * i;
+        block->mask |= 0xFFULL << 8 * i;
+    }
+
+    // machines running the ROM pick the block up on their next entry
+    __atomic_store_n(&tier->block[start], block, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Compile the blocks that got hot, then the whole ROM, until the tier is destroyed
+ */
+static void *tier_compiler(void *arg)
+{
+    chip_tier *tier = arg;
+
+    pthread_mutex_lock(&tier->lock);
+
+    while (!tier->stop)
+    {
+        if (tier->queued)
+        {
+            uint16 start = tier->queue[--tier->queued];
+
+            pthread_mutex_unlock(&tier->lock);
+            tier_compile(tier, start);
+            pthread_mutex_lock(&tier->lock);
+        }
+        else if (tier->native_pending == 1)
+        {
+            tier->native_pending = 2;
+
+            pthread_mutex_unlock(&tier->lock);
+            chip_aot *aot = util_aot_open(tier->translations, tier->rom, tier->size);
+            pthread_mutex_lock(&tier->lock);
+
+            if (aot)
+            {
+                tier->aot = aot;
+                __atomic_store_n(&tier->native_frame, aot->frame, __ATOMIC_RELEASE);
+                __atomic_store_n(&tier->native, aot->run, __ATOMIC_RELEASE);
+            }
+        }
+        else
+            pthread_cond_wait(&tier->wake, &tier->lock);
+    }
+
+    pthread_mutex_unlock(&tier->lock);
+
+    return 0;
+}
+
+/**
+ * @brief Hand work to the compiler thread: a block, or the whole ROM
+ *
+ * @param start the address of the block to compile
+ * @param native compile the whole ROM instead
+ */
+static void tier_request(chip_tier *tier, uint16 start, uint8 native)
+{
+    pthread_mutex_lock(&tier->lock);
+
+    if (native && !tier->native_pending)
+        __atomic_store_n(&tier->native_pending, 1, __ATOMIC_RELAXED);
+    else if (!native && !tier->pending[start])
+    {
+        __atomic_store_n(&tier->pending[start], 1, __ATOMIC_RELAXED);
+        tier->queue[tier->queued++] = start;
+    }
+
+    pthread_cond_signal(&tier->wake);
+    pthread_mutex_unlock(&tier->lock);
+}
+
+/**
+ * @brief Whether memory still holds the bytes a block was decoded from
+ *
+ * The first 8 bytes, all of most blocks, are compared as one word; memory is
+ * followed by its guard, so the load never leaves it.
+ */
+static inline uint8 tier_same(const uint8 *memory, const chip_block *block)
+{
+    uint64 head;
+    memcpy(&head, memory, 8);
+
+    if ((head & block->mask) != block->head)
+        return 0;
+
+    for (uint8 i = 8; i < 2 * block->length; i++)
+        if (memory[i] != block->bytes[i])
+            return 0;
+
+    return 1;
+}
+
+/**
+ * @brief Whether a write to memory by op changed the instructions of the block after it, up to end
+ *
+ * The block's bytes are only checked on entry, so Fx33 and Fx55 may replace
+ * instructions it has yet to run.
+ *
+ * @param memory the running chip's memory, from the instruction after op
+ */
+static inline uint8 tier_rewritten(const uint8 *memory, const chip_block *block, const chip_op *op, const chip_op *end)
+{
+    uint16 next = 2 * (op + 1 - block->op);
+
+    return op + 1 < end && memcmp(memory, block->bytes + next, 2 * (end - block->op) - next) != 0;
+}
+
+/**
+ * @brief Run a predecoded block on the running chip, or its first instructions
+ *
+ * @param limit the instructions left to run: a longer block stops before its end
+ */
+static void tier_block(const chip_block *block, uint64 limit)
+{
+    chip_state *c = chip;
+    uint8 *V = c->V;
+    const chip_op *op = block->op, *end = block->op + (block->length < limit ? block->length : limit);
+    uint16 pc = block->start;
+
+    c->cycles += end - op;
+
+    for (; op < end; op++, pc += 2)
+    {
+        // a pair cut by the end of the run executes its first half alone
+        if (op->fused && op + 1 < end)
+        {
+            const chip_op *next = op + 1;
+
+            switch (op->fused)
+            {
+            case TIER_LD_LD:
+                V[op->x] = op->nnn;
+                V[next->x] = next->nnn;
+                break;
+            case TIER_LD3_DRW:
+                c->I = op->nnn;
+                DRW(next->x, next->y, next->n);
+                break;
+            case TIER_LD3_LD6:
+                c->I = op->nnn;
+                LD6(next->x);
+                break;
+            case TIER_ADD_SE:
+                V[op->x] += op->nnn;
+                c->PC = pc + (V[op->x] == next->nnn ? 6 : 4);
+                return;
+            case TIER_ADD_SNE:
+                V[op->x] += op->nnn;
+                c->PC = pc + (V[op->x] != next->nnn ? 6 : 4);
+                return;
+            }
+
+            op++, pc += 2;
+            continue;
+        }
+
+        switch (op->kind)
+        {
+        case TIER_EXIT:
+            c->PC = pc;
+            util_chip_execute(op->opcode);
+            return;
+        case TIER_JP:
+            c->PC = op->nnn;
+            return;
+        case TIER_CALL:
+            c->SP = (c->SP + 1) & 0xF;
+            c->stack[c->SP] = pc + 2;
+            c->PC = op->nnn;
+            return;
+        case TIER_SE:
+            c->PC = pc + (V[op->x] == op->nnn ? 4 : 2);
+            return;
+        case TIER_SNE:
+            c->PC = pc + (V[op->x] != op->nnn ? 4 : 2);
+            return;
+        case TIER_SE2:
+            c->PC = pc + (V[op->x] == V[op->y] ? 4 : 2);
+            return;
+        case TIER_SNE2:
+            c->PC = pc + (V[op->x] != V[op->y] ? 4 : 2);
+            return;
+        case TIER_SKP:
+            c->PC = pc + (c->key_state[V[op->x] & 0xF] ? 4 : 2);
+            return;
+        case TIER_SKNP:
+            c->PC = pc + (c->key_state[V[op->x] & 0xF] ? 2 : 4);
+            return;
+        case TIER_CLS:
+            CLS();
+            break;
+        case TIER_LD:
+            V[op->x] = op->nnn;
+            break;
+        case TIER_ADD:
+            V[op->x] += op->nnn;
+            break;
+        case TIER_LD2:
+            V[op->x] = V[op->y];
+            break;
+        case TIER_OR:
+            V[op->x] |= V[op->y];
+            if (!(c->quirks & CHIP_QUIRK_LOGIC))
+                V[0xF] = 0;
+            break;
+        case TIER_AND:
+            V[op->x] &= V[op->y];
+            if (!(c->quirks & CHIP_QUIRK_LOGIC))
+                V[0xF] = 0;
+            break;
+        case TIER_XOR:
+            V[op->x] ^= V[op->y];
+            if (!(c->quirks & CHIP_QUIRK_LOGIC))
+                V[0xF] = 0;
+            break;
+        case TIER_ADD2:
+        {
+            uint8 flag = V[op->x] + V[op->y] > 0xFF;
+            V[op->x] += V[op->y];
+            V[0xF] = flag;
+            break;
+        }
+        case TIER_SUB:
+        {
+            uint8 flag = V[op->x] > V[op->y];
+            V[op->x] -= V[op->y];
+            V[0xF] = flag;
+            break;
+        }
+        case TIER_SUBN:
+        {
+            uint8 flag = V[op->y] > V[op->x];
+            V[op->x] = V[op->y] - V[op->x];
+            V[0xF] = flag;
+            break;
+        }
+        case TIER_SHR:
+        {
+            uint8 value = V[c->quirks & CHIP_QUIRK_SHIFT ? op->x : op->y];
+            V[op->x] = value >> 1;
+            V[0xF] = value & 1;
+            break;
+        }
+        case TIER_SHL:
+        {
+            uint8 value = V[c->quirks & CHIP_QUIRK_SHIFT ? op->x : op->y];
+            V[op->x] = value << 1;
+            V[0xF] = value >> 7;
+            break;
+        }
+        case TIER_LD3:
+            c->I = op->nnn;
+            break;
+        case TIER_RND:
+            RND(op->x, op->nnn);
+            break;
+        case TIER_DRW:
+            DRW(op->x, op->y, op->n);
+            break;
+        case TIER_LD4:
+            V[op->x] = c->delay_timer;
+            break;
+        case TIER_LDDT:
+            c->delay_timer = V[op->x];
+            break;
+        case TIER_LDST:
+            c->sound_timer = V[op->x];
+            break;
+        case TIER_ADDI:
+            c->I = (c->I + V[op->x]) & 0xFFF;
+            break;
+        case TIER_LDF:
+            c->I = V[op->x] * 5;
+            break;
+        case TIER_LDB:
+        case TIER_LDI:
+        {
+            if (op->kind == TIER_LDB)
+                LDB(op->x);
+            else
+                LDI(op->x);
+
+            // the rest of a rewritten block runs on the interpreter
+            if (tier_rewritten(c->memory + pc + 2, block, op, end))
+            {
+                c->cycles -= end - op - 1;
+                c->PC = pc + 2;
+                return;
+            }
+            break;
+        }
+        case TIER_LD6:
+            LD6(op->x);
+            break;
+        default:
+            break;
+        }
+    }
+
+    c->PC = pc;
+}
+
+/**
+ * @brief Prepare tiered execution of a ROM
+ *
+ * Machines start on the interpreter. Blocks entered CHIP_TIER_HOT times are
+ * predecoded on a background thread; with a cache directory, the ROM is also
+ * compiled to native code once it ran CHIP_TIER_NATIVE instructions. Either
+ * switch is published atomically: blocks are picked up at their next entry and
+ * native code at the next run, so cold code never pays for compilation.
+ *
+ * @param rom the ROM's bytes
+ * @param size the ROM's length
+ * @param translations cache directory of native translations, 0 to stop at predecoded blocks
+ * @return the tier, 0 if error occurred
+ */
+chip_tier *util_tier_create(const uint8 *rom, uint32 size, const char *translations)
+{
+    chip_tier *tier = calloc(1, sizeof(chip_tier));
+
+    if (tier == 0)
+    {
+        fprintf(stderr, "Error while creating tier: out of memory\n");
+        return 0;
+    }
+
+    tier->size = size < sizeof(tier->rom) ? size : sizeof(tier->rom);
+    memcpy(tier->rom, rom, tier->size);
+    tier->translations = translations;
+
+    pthread_mutex_init(&tier->lock, 0);
+    pthread_cond_init(&tier->wake, 0);
+
+    if (pthread_create(&tier->compiler, 0, tier_compiler, tier))
+    {
+        perror("Failed to start compiler thread.\n");
+        free(tier);
+        return 0;
+    }
+
+    return tier;
+}
+
+/**
+ * @brief Run the running chip for a number of instructions on the best tier ready
+ *
+ * @param cycles the instructions to run
+ */
+void util_tier_run(chip_tier *tier, uint32 cycles)
+{
+    void (*native)(uint32) = __atomic_load_n(&tier->native, __ATOMIC_ACQUIRE);
+
+    if (native)
+    {
+        native(cycles);
+        return;
+    }
+
+    // instructions run by every machine on the ROM: a lost update only delays compilation
+    uint64 instructions = __atomic_load_n(&tier->instructions, __ATOMIC_RELAXED) + cycles;
+    __atomic_store_n(&tier->instructions, instructions, __ATOMIC_RELAXED);
+
+    if (tier->translations && instructions >= CHIP_TIER_NATIVE && !__atomic_load_n(&tier->native_pending, __ATOMIC_RELAXED))
+        tier_request(tier, 0, 1);
+
+    uint64 end = chip->cycles + cycles;
+
+    // a PC reached by falling through is not a block entry; where the run starts is
+    uint16 last = chip->PC + 2;
+
+    while (chip->cycles < end)
+    {
+        uint16 pc = chip->PC;
+
+        if (pc != (uint16)(last + 2) && pc < 0x1000)
+        {
+            chip_block *block = __atomic_load_n(&tier->block[pc], __ATOMIC_ACQUIRE);
+
+            // a block only runs while the ROM did not overwrite it
+            if (block && tier_same(chip->memory + pc, block))
+            {
+                tier_block(block, end - chip->cycles);
+                last = chip->PC;
+                continue;
+            }
+
+            if (block == 0)
+            {
+                uint32 hits = __atomic_load_n(&tier->hits[pc], __ATOMIC_RELAXED) + 1;
+                __atomic_store_n(&tier->hits[pc], hits, __ATOMIC_RELAXED);
+
+                if (hits >= CHIP_TIER_HOT && !__atomic_load_n(&tier->pending[pc], __ATOMIC_RELAXED))
+                    tier_request(tier, pc, 0);
+            }
+        }
+
+        last = pc;
+        util_chip_cycle();
+    }
+}
+
+/**
+ * @brief The same as util_chip_frame, on the best tier ready
+ */
+void util_tier_frame(chip_tier *tier)
+{
+    void (*frame)() = __atomic_load_n(&tier->native_frame, __ATOMIC_ACQUIRE);
+
+    if (frame)
+    {
+        frame();
+        return;
+    }
+
+    if (chip->delay_timer > 0)
+        chip->delay_timer--;
+
+    if (chip->sound_timer > 0)
+        chip->sound_timer--;
+
+    if (util_chip_suspended())
+        chip->cycles += CHIP_FRAME_CYCLES;
+    else
+        util_tier_run(tier, CHIP_FRAME_CYCLES);
+
+    for (uint8 i = 0; i < 0x10; i++)
+        chip->key_prev[i] = chip->key_state[i];
+}
+
+/**
+ * @brief Stop the compiler thread and free every tier of a ROM, no machine running it
+ */
+void util_tier_destroy(chip_tier *tier)
+{
+    pthread_mutex_lock(&tier->lock);
+    tier->stop = 1;
+    pthread_cond_signal(&tier->wake);
+    pthread_mutex_unlock(&tier->lock);
+
+    pthread_join(tier->compiler, 0);
+
+    for (uint32 i = 0; i < 0x1000; i++)
+        free(tier->block[i]);
+
+    if (tier->aot)
+        util_aot_close(tier->aot);
+
+    pthread_mutex_destroy(&tier->lock);
+    pthread_cond_destroy(&tier->wake);
+    free(tier);
+}
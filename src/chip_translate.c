@@ -0,0 +1,458 @@
+#include <chip/chip.h>
+#include <chip/chip_analysis.h>
+#include <chip/chip_translate.h>
+
+#include <stdio.h>
+#include <string.h>
+
+// how an instruction uses VF
+#define TRANSLATE_VF_READ 0x1
+#define TRANSLATE_VF_KILL 0x2
+#define TRANSLATE_VF_FLAG 0x4
+
+/**
+ * @brief How an instruction uses VF: whether it may read it, always overwrites
+ * it, and whether it computes a flag into it that can be skipped
+ *
+ * Registers an instruction reads depending on quirks count as read either way.
+ */
+static uint8 translate_vf(uint16 opcode)
+{
+    uint8 x = (opcode >> 8) & 0xF, y = (opcode >> 4) & 0xF, kk = opcode & 0xFF, n = opcode & 0xF;
+    uint8 reads = x == 0xF, both = x == 0xF || y == 0xF;
+
+    switch (opcode >> 12)
+    {
+    case 0x3:
+    case 0x4:
+    case 0xE:
+        return reads;
+    case 0x5:
+    case 0x9:
+        return both;
+    case 0x6:
+    case 0xC:
+        return x == 0xF ? TRANSLATE_VF_KILL : 0;
+    case 0x7:
+        return reads;
+    case 0x8:
+        if (n == 0)
+            return (y == 0xF) | (x == 0xF ? TRANSLATE_VF_KILL : 0);
+        if (n <= 3)
+            return both | TRANSLATE_VF_FLAG;
+        if (n <= 7 || n == 0xE)
+            return both | TRANSLATE_VF_KILL | TRANSLATE_VF_FLAG;
+        return 0;
+    case 0xB:
+        return TRANSLATE_VF_READ;
+    case 0xD:
+        return both | TRANSLATE_VF_KILL | TRANSLATE_VF_FLAG;
+    case 0xF:
+        switch (kk)
+        {
+        case 0x07:
+        case 0x65:
+            return x == 0xF ? TRANSLATE_VF_KILL : 0;
+        case 0x15:
+        case 0x18:
+        case 0x1E:
+        case 0x29:
+        case 0x33:
+        case 0x55:
+            return reads;
+        default:
+            return 0;
+        }
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Whether an instruction writes memory, which may hold the rest of its block
+ */
+static uint8 translate_writes(uint16 opcode)
+{
+    return (opcode & 0xF0FF) == 0xF055 || (opcode & 0xF0FF) == 0xF033;
+}
+
+/**
+ * @brief Write the C statements of one instruction, the same as util_chip_execute
+ *
+ * Instructions that change PC set it themselves; the others leave it to the end of the block.
+ *
+ * @param addr the instruction's address
+ * @param flag whether VF is read after the instruction: without, the flags it computes are skipped
+ */
+static void translate_instruction(FILE *file, uint16 addr, uint16 opcode, uint8 flag)
+{
+    uint8 x = (opcode >> 8) & 0xF, y = (opcode >> 4) & 0xF, kk = opcode & 0xFF, n = opcode & 0xF;
+    uint16 nnn = opcode & 0xFFF;
+    char text[32];
+
+    util_analysis_mnemonic(opcode, text, sizeof(text));
+    fprintf(file, "        // %03X: %04X %s%s\n", addr, opcode, text, flag || !(translate_vf(opcode) & TRANSLATE_VF_FLAG) ? "" : ", VF dead");
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00E0)
+            fprintf(file, "        CLS();\n");
+        else if (opcode == 0x00EE)
+            fprintf(file, "        RET();\n");
+        else
+            fprintf(file, "        chip->PC = 0x%03X;\n", nnn);
+        return;
+    case 0x1:
+        fprintf(file, "        chip->PC = 0x%03X;\n", nnn);
+        return;
+    case 0x2:
+        fprintf(file, "        chip->SP = (chip->SP + 1) & 0xF;\n");
+        fprintf(file, "        chip->stack[chip->SP] = 0x%03X;\n", addr + 2);
+        fprintf(file, "        chip->PC = 0x%03X;\n", nnn);
+        return;
+    case 0x3:
+        fprintf(file, "        chip->PC = chip->V[0x%X] == 0x%02X ? 0x%03X : 0x%03X;\n", x, kk, addr + 4, addr + 2);
+        return;
+    case 0x4:
+        fprintf(file, "        chip->PC = chip->V[0x%X] != 0x%02X ? 0x%03X : 0x%03X;\n", x, kk, addr + 4, addr + 2);
+        return;
+    case 0x5:
+        if (n == 0)
+            fprintf(file, "        chip->PC = chip->V[0x%X] == chip->V[0x%X] ? 0x%03X : 0x%03X;\n", x, y, addr + 4, addr + 2);
+        return;
+    case 0x6:
+        fprintf(file, "        chip->V[0x%X] = 0x%02X;\n", x, kk);
+        return;
+    case 0x7:
+        fprintf(file, "        chip->V[0x%X] += 0x%02X;\n", x, kk);
+        return;
+    case 0x8:
+        switch (n)
+        {
+        case 0x0:
+            fprintf(file, "        chip->V[0x%X] = chip->V[0x%X];\n", x, y);
+            return;
+        case 0x1:
+        case 0x2:
+        case 0x3:
+            fprintf(file, "        chip->V[0x%X] %s= chip->V[0x%X];\n", x, n == 1 ? "|" : n == 2 ? "&" : "^", y);
+            if (flag)
+                fprintf(file, "        if (!(chip->quirks & CHIP_QUIRK_LOGIC))\n            chip->V[0xF] = 0;\n");
+            return;
+        case 0x4:
+            if (flag)
+                fprintf(file, "        flag = chip->V[0x%X] + chip->V[0x%X] > 0xFF;\n", x, y);
+            fprintf(file, "        chip->V[0x%X] += chip->V[0x%X];\n", x, y);
+            if (flag)
+                fprintf(file, "        chip->V[0xF] = flag;\n");
+            return;
+        case 0x5:
+            if (flag)
+                fprintf(file, "        flag = chip->V[0x%X] > chip->V[0x%X];\n", x, y);
+            fprintf(file, "        chip->V[0x%X] -= chip->V[0x%X];\n", x, y);
+            if (flag)
+                fprintf(file, "        chip->V[0xF] = flag;\n");
+            return;
+        case 0x6:
+        case 0xE:
+            fprintf(file, "        value = chip->V[chip->quirks & CHIP_QUIRK_SHIFT ? 0x%X : 0x%X];\n", x, y);
+            fprintf(file, "        chip->V[0x%X] = value %s 1;\n", x, n == 6 ? ">>" : "<<");
+            if (flag)
+                fprintf(file, "        chip->V[0xF] = %s;\n", n == 6 ? "value & 1" : "value >> 7");
+            return;
+        case 0x7:
+            if (flag)
+                fprintf(file, "        flag = chip->V[0x%X] > chip->V[0x%X];\n", y, x);
+            fprintf(file, "        chip->V[0x%X] = chip->V[0x%X] - chip->V[0x%X];\n", x, y, x);
+            if (flag)
+                fprintf(file, "        chip->V[0xF] = flag;\n");
+            return;
+        default:
+            return;
+        }
+    case 0x9:
+        if (n == 0)
+            fprintf(file, "        chip->PC = chip->V[0x%X] != chip->V[0x%X] ? 0x%03X : 0x%03X;\n", x, y, addr + 4, addr + 2);
+        return;
+    case 0xA:
+        fprintf(file, "        chip->I = 0x%03X;\n", nnn);
+        return;
+    case 0xB:
+        fprintf(file, "        JP2(0x%03X);\n", nnn);
+        return;
+    case 0xC:
+        fprintf(file, "        RND(0x%X, 0x%02X);\n", x, kk);
+        return;
+    case 0xD:
+        fprintf(file, "        %s(0x%X, 0x%X, %u);\n", flag ? "DRW" : "DRW_NOFLAG", x, y, n);
+        return;
+    case 0xE:
+        if (kk == 0x9E || kk == 0xA1)
+            fprintf(file, "        chip->PC = %schip->key_state[chip->V[0x%X] & 0xF] ? 0x%03X : 0x%03X;\n", kk == 0x9E ? "" : "!", x, addr + 4,
+                    addr + 2);
+        return;
+    default:
+        switch (kk)
+        {
+        case 0x07:
+            fprintf(file, "        chip->V[0x%X] = chip->delay_timer;\n", x);
+            return;
+        case 0x0A:
+            // LD5 moves PC back onto itself while no key is pressed
+            fprintf(file, "        chip->PC = 0x%03X;\n", addr + 2);
+            fprintf(file, "        LD5(0x%X);\n", x);
+            return;
+        case 0x15:
+            fprintf(file, "        chip->delay_timer = chip->V[0x%X];\n", x);
+            return;
+        case 0x18:
+            fprintf(file, "        chip->sound_timer = chip->V[0x%X];\n", x);
+            return;
+        case 0x1E:
+            fprintf(file, "        chip->I = (chip->I + chip->V[0x%X]) & 0xFFF;\n", x);
+            return;
+        case 0x29:
+            fprintf(file, "        chip->I = chip->V[0x%X] * 5;\n", x);
+            return;
+        case 0x33:
+            fprintf(file, "        LDB(0x%X);\n", x);
+            return;
+        case 0x55:
+            fprintf(file, "        LDI(0x%X);\n", x);
+            return;
+        case 0x65:
+            fprintf(file, "        LD6(0x%X);\n", x);
+            return;
+        default:
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Write a jump to the check of the block at addr, or back to the dispatcher without one
+ */
+static void translate_chain(FILE *file, const chip_analysis *rom, uint16 addr)
+{
+    if (addr < 0x1000 && rom->addr[addr] & CHIP_ADDR_LEADER)
+        fprintf(file, "goto enter_%03X;\n", addr);
+    else
+        fprintf(file, "continue;\n");
+}
+
+/**
+ * @brief Write how a block is left, PC being set already
+ *
+ * Exits known statically go straight to the next block, which is only
+ * entered if it passes the same checks as from the dispatcher. Calls push
+ * their return block on a shadow stack that RET pops, checked against the
+ * address it actually returns to; anything else goes back to the dispatcher.
+ *
+ * @param addr the address of the block's last instruction
+ */
+static void translate_exit(FILE *file, const chip_analysis *rom, uint16 addr, uint16 opcode)
+{
+    uint16 nnn = opcode & 0xFFF;
+
+    if (!util_analysis_ends(opcode))
+    {
+        fprintf(file, "        ");
+        translate_chain(file, rom, addr + 2);
+    }
+    else if (opcode == 0x00EE && rom->calls)
+    {
+        fprintf(file, "        if (depth && shadow_to[--depth & 0xF] == chip->PC)\n            goto *shadow[depth & 0xF];\n");
+        fprintf(file, "        continue;\n");
+    }
+    else if (opcode >> 12 == 0x0 || opcode >> 12 == 0x1)
+    {
+        fprintf(file, "        ");
+        translate_chain(file, rom, nnn);
+    }
+    else if (opcode >> 12 == 0x2)
+    {
+        // a CALL at the end of memory returns past it, to no block
+        if (addr + 2 < 0x1000 && rom->addr[addr + 2] & CHIP_ADDR_LEADER)
+        {
+            fprintf(file, "        shadow_to[depth & 0xF] = 0x%03X;\n", addr + 2);
+            fprintf(file, "        shadow[depth++ & 0xF] = &&enter_%03X;\n", addr + 2);
+        }
+
+        fprintf(file, "        ");
+        translate_chain(file, rom, nnn);
+    }
+    else if (opcode == 0x00EE || opcode >> 12 == 0xB || opcode >> 12 == 0xF)
+        fprintf(file, "        continue;\n");
+    else
+    {
+        // skips
+        fprintf(file, "        if (chip->PC == 0x%03X)\n            ", addr + 4);
+        translate_chain(file, rom, addr + 4);
+        fprintf(file, "        ");
+        translate_chain(file, rom, addr + 2);
+    }
+
+    fprintf(file, "\n");
+}
+
+/**
+ * @brief Write the check following a write to memory inside a block, from next to its end at end
+ *
+ * The block's bytes are only checked on entry, so a write may replace
+ * instructions it has yet to run: the rest of the block is compared again,
+ * and if it changed the instructions not run are given back and the
+ * interpreter resumes at next.
+ *
+ * @param left the block's instructions after the write
+ */
+static void translate_rewritten(FILE *file, const char *name, uint16 next, uint16 end, uint32 left)
+{
+    fprintf(file, "        if (memcmp(chip->memory + 0x%03X, %s_rom + 0x%03X, %u) != 0)\n", next, name, next - 0x200, end - next);
+    fprintf(file, "        {\n            chip->cycles -= %lu;\n            chip->PC = 0x%03X;\n            continue;\n        }\n", left, next);
+}
+
+/**
+ * @brief Write a block: its instructions up to the first that jumps, or up to the next block
+ *
+ * Flags into VF are only computed if VF is read before being overwritten. A
+ * run may stop, and the interpreter take over, after any block, so VF is
+ * live wherever the block is left: at its end, and after any write to
+ * memory, where the rest of the block may be gone.
+ */
+static void translate_block(FILE *file, chip_translation *translation, const char *name, uint16 start)
+{
+    const chip_analysis *rom = &translation->rom;
+    uint16 addr = util_analysis_extent(rom, start);
+    uint16 opcode = util_analysis_opcode(rom, addr - 2);
+    uint32 length = (addr - start) / 2;
+    uint8 live[0x800];
+
+    live[length - 1] = 1;
+
+    for (uint32 i = length - 1; i > 0; i--)
+    {
+        uint8 vf = translate_vf(util_analysis_opcode(rom, start + 2 * i));
+        uint8 exits = translate_writes(util_analysis_opcode(rom, start + 2 * (i - 1)));
+
+        live[i - 1] = exits || (vf & TRANSLATE_VF_READ) || (live[i] && !(vf & TRANSLATE_VF_KILL));
+    }
+
+    fprintf(file, "    block_%03X:\n", start);
+    fprintf(file, "        chip->cycles += %lu;\n", length);
+
+    for (uint32 i = 0; i < length; i++)
+    {
+        uint16 instruction = util_analysis_opcode(rom, start + 2 * i);
+
+        translate_instruction(file, start + 2 * i, instruction, live[i]);
+        translation->flags += !live[i] && (translate_vf(instruction) & TRANSLATE_VF_FLAG);
+
+        if (translate_writes(instruction) && i + 1 < length)
+            translate_rewritten(file, name, start + 2 * (i + 1), addr, length - i - 1);
+    }
+
+    if (!util_analysis_ends(opcode))
+        fprintf(file, "        chip->PC = 0x%03X;\n", addr);
+
+    translate_exit(file, rom, addr - 2, opcode);
+}
+
+/**
+ * @brief Write the C translation of a ROM
+ *
+ * The translation defines name_load, which loads the ROM into the running
+ * chip, name_run, which runs the running chip for a number of instructions,
+ * and name_frame, the same as util_chip_frame. A block runs only if it fits
+ * the instructions left and its bytes are still those of the ROM: anything
+ * else, including code the ROM wrote itself, goes through util_chip_cycle.
+ * Blocks jump to each other directly, through labels as values (GNU C).
+ *
+ * @param path the ROM's name, for the header comment
+ * @param name prefix of the functions defined
+ * @param standalone also write a main running the ROM headless
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 util_translate_write(FILE *file, chip_translation *translation, const char *path, const char *name, uint8 standalone)
+{
+    const chip_analysis *rom = &translation->rom;
+
+    translation->flags = 0;
+    fprintf(file, "// %s translated by chip_translate version %u\n\n", path, CHIP_TRANSLATE_VERSION);
+    fprintf(file, "#include <stdio.h>\n#include <stdlib.h>\n#include <string.h>\n\n#include <chip/chip.h>\n\n");
+
+    fprintf(file, "static const uint8 %s_rom[%lu] = {", name, rom->size ? rom->size : 1);
+    for (uint32 i = 0; i < rom->size; i++)
+        fprintf(file, "%s0x%02X,", i % 16 ? " " : "\n    ", rom->bytes[i]);
+    fprintf(file, "\n};\n\n");
+
+    fprintf(file, "void %s_load()\n{\n    util_chip_load_ROM_bytes(%s_rom, %lu);\n}\n\n", name, name, rom->size);
+
+    fprintf(file, "void %s_run(uint32 cycles)\n{\n", name);
+    // scratch for the 8xy instructions that set VF
+    uint8 scratch = 0;
+    for (uint16 addr = 0x200; addr < 0x1000; addr++)
+        if (rom->addr[addr] & CHIP_ADDR_LEADER)
+            for (uint16 a = addr, end = util_analysis_extent(rom, addr); a < end; a += 2)
+            {
+                uint16 opcode = util_analysis_opcode(rom, a);
+                scratch |= (opcode & 0xF000) == 0x8000 && (((opcode & 0xF) >= 4 && (opcode & 0xF) <= 7) || (opcode & 0xF) == 0xE);
+            }
+
+    fprintf(file, "    uint64 end = chip->cycles + cycles;\n%s", scratch ? "    uint8 flag, value;\n" : "");
+
+    // return blocks of the calls made, most recent last
+    if (rom->calls)
+        fprintf(file, "    void *shadow[0x10];\n    uint16 shadow_to[0x10];\n    uint8 depth = 0;\n");
+
+    fprintf(file, "\n");
+    fprintf(file, "    while (chip->cycles < end)\n    {\n");
+    fprintf(file, "        switch (chip->PC)\n        {\n");
+
+    for (uint16 addr = 0x200; addr < 0x1000; addr++)
+    {
+        if (!(rom->addr[addr] & CHIP_ADDR_LEADER))
+            continue;
+
+        uint16 end = util_analysis_extent(rom, addr);
+
+        fprintf(file, "        case 0x%03X:\n        enter_%03X:\n", addr, addr);
+        fprintf(file, "            if (end - chip->cycles >= %lu && memcmp(chip->memory + 0x%03X, %s_rom + 0x%03X, %lu) == 0)\n", (uint32)(end - addr) / 2,
+                addr, name, addr - 0x200, (uint32)(end - addr));
+        fprintf(file, "                goto block_%03X;\n            break;\n", addr);
+    }
+
+    // blocks chained to a block that does not fit the instructions left may get here with none left
+    fprintf(file, "        }\n\n        if (chip->cycles < end)\n            util_chip_cycle();\n        continue;\n\n");
+
+    for (uint16 addr = 0x200; addr < 0x1000; addr++)
+        if (rom->addr[addr] & CHIP_ADDR_LEADER)
+            translate_block(file, translation, name, addr);
+
+    fprintf(file, "    }\n}\n\n");
+
+    fprintf(file, "void %s_frame()\n{\n", name);
+    fprintf(file, "    if (chip->delay_timer > 0)\n        chip->delay_timer--;\n\n");
+    fprintf(file, "    if (chip->sound_timer > 0)\n        chip->sound_timer--;\n\n");
+    fprintf(file, "    if (util_chip_suspended())\n        chip->cycles += CHIP_FRAME_CYCLES;\n    else\n        %s_run(CHIP_FRAME_CYCLES);\n\n", name);
+    fprintf(file, "    for (uint8 i = 0; i < 0x10; i++)\n        chip->key_prev[i] = chip->key_state[i];\n}\n");
+
+    if (standalone)
+    {
+        fprintf(file, "\n// usage: [frames] [seed], prints the instructions run and the framebuffer hash\n");
+        fprintf(file, "int main(int argc, char **argv)\n{\n");
+        fprintf(file, "    uint64 frames = argc > 1 ? strtoull(argv[1], 0, 10) : 600;\n\n");
+        fprintf(file, "    util_chip_init();\n    %s_load();\n    chip->seed = argc > 2 ? strtoull(argv[2], 0, 10) : 0;\n\n", name);
+        fprintf(file, "    for (uint64 f = 0; f < frames; f++)\n        %s_frame();\n\n", name);
+        fprintf(file, "    printf(\"%%llu\\t%%016llx\\n\", chip->cycles, util_chip_hash(chip->display, sizeof(chip->display)));\n");
+        fprintf(file, "    return 0;\n}\n");
+    }
+
+    if (ferror(file))
+    {
+        perror("Failed to write translation.\n");
+        return 1;
+    }
+
+    return 0;
+}
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include <chip/chip.h>
 #include <SDL2/SDL.h>
@@ -17,6 +18,9 @@ SDL_Window *window;
 // SDL renderer component
 SDL_Renderer *renderer;
 
+// machine image right after the ROM was loaded
+chip_state rom_image;
+
 // display vars
 uint8 loop;
 float delta_time;
@@ -25,15 +29,13 @@ uint8 util_sdl_init();
 uint8 util_sdl_window_init();
 uint8 util_sdl_renderer_init();
 
-uint8 util_chip_reset();
+uint8 util_chip_load();
+void util_chip_reset();
 void util_chip_open_rom();
 
 void util_render();
 uint8 util_keymap(SDL_Keycode);
 
-// op code
-uint16 op_code;
-
 // key pressed
 uint8 key;
 
@@ -56,7 +58,7 @@ int main()
     key = 0xFF;
 
     util_chip_open_rom();
-    if (util_chip_reset())
+    if (util_chip_load())
         return 1;
 
     loop = 1;
@@ -85,7 +87,7 @@ int main()
                     if (event.key.keysym.sym == SDLK_o)
                     {
                         util_chip_open_rom();
-                        util_chip_reset();
+                        util_chip_load();
                     }
 
                     if (event.key.keysym.sym == SDLK_i)
@@ -93,36 +95,20 @@ int main()
 
                     key = util_keymap(event.key.keysym.sym);
                     if (key != 0xFF)
-                        key_state[key] = 1;
+                        chip->key_state[key] = 1;
                 }
 
                 if (event.key.state == SDL_RELEASED)
                 {
                     key = util_keymap(event.key.keysym.sym);
                     if (key != 0xFF)
-                        key_state[key] = 0;
+                        chip->key_state[key] = 0;
                 }
             }
 
-            if (delay_timer > 0)
-                delay_timer--;
-
-            if (sound_timer > 0)
-            {
-                // TO-DO: ADD SOUND
-                sound_timer--;
-            }
-
-            // fetch-execute cycle
-            for (int i = 0; i < 10; i++)
-            {
-                frame++;
-                op_code = (memory[PC] << 8) + memory[PC + 1];
-                util_chip_execute(op_code);
-            }
-
-            for (uint8 i = 0; i < 0x10; i++)
-                key_prev[i] = key_state[i];
+            // TO-DO: ADD SOUND
+            frame += CHIP_FRAME_CYCLES;
+            util_chip_frame();
 
             // render chip display
             util_render();
@@ -205,13 +191,14 @@ void util_chip_open_rom()
 }
 
 /**
- * @brief 
+ * @brief Load rom_file into a fresh chip and keep its image for resets
  * 
  * @return 1 if error occurred, 0 otherwise  
  */
-uint8 util_chip_reset()
+uint8 util_chip_load()
 {
     util_chip_init();
+    chip->seed = time(0);
 
     if (rom_file == 0)
     {
@@ -221,10 +208,21 @@ uint8 util_chip_reset()
 
     if(util_chip_load_ROM(rom_file))
         return 1;
+
+    util_chip_snapshot(&rom_image);
         
     return 0;
 }
 
+/**
+ * @brief Restart the loaded ROM from its image
+ * 
+ */
+void util_chip_reset()
+{
+    util_chip_restore(&rom_image);
+}
+
 /**
  * @brief Render chip display
  * 
@@ -247,7 +245,7 @@ void util_render()
             rect->w = scaling;
             rect->h = scaling;
 
-            if (display[yy][xx])
+            if (chip->display[yy][xx])
                 SDL_SetRenderDrawColor(renderer,
                                        red(PRIMARY_COLOR),
                                        green(PRIMARY_COLOR),
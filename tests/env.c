@@ -0,0 +1,73 @@
+#include <chip/chip.h>
+#include <chip/chip_env.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// waits on Fx0A forever: LD V0, K; JP 0x200
+static const uint8 wait_rom[] = {0xF0, 0x0A, 0x12, 0x00};
+
+// the episode ends after 4 frames of instructions
+static uint8 env_done(const chip_state *machine, void *user)
+{
+    (void)user;
+    return machine->cycles >= 4 * CHIP_FRAME_CYCLES;
+}
+
+/**
+ * @brief A done hook that fires while the machine is parked on Fx0A resets it, as on the pool
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+static uint8 test_suspended_done(const char *fileName)
+{
+    chip_vec_env *vec = util_vec_env_create(fileName, 2, 2, 0);
+
+    if (vec == 0)
+        return 1;
+
+    util_vec_env_hooks(vec, 0, env_done, 0);
+
+    // both machines reach the wait
+    uint16 idle[2] = {0, 0};
+    const chip_step *step = util_vec_env_step(vec, idle, 1);
+    uint8 error = step[0].done || step[1].done || !vec->env[0].machine.waiting;
+
+    // machine 0 stays suspended, machine 1 presses a key and runs
+    uint16 action[2] = {0, 1};
+    uint8 suspended = util_env_suspended(&vec->env[0], action[0]) && !util_env_suspended(&vec->env[1], action[1]);
+    step = util_vec_env_step(vec, action, 3);
+
+    for (uint32 i = 0; i < 2; i++)
+        if (!step[i].done || vec->env[i].machine.cycles != 0 || vec->env[i].frames != 0)
+        {
+            fprintf(stderr, "env %lu: done %u but not reset\n", i, step[i].done);
+            error = 1;
+        }
+
+    util_vec_env_destroy(vec);
+
+    return error || !suspended;
+}
+
+int main()
+{
+    char fileName[] = "/tmp/chipEmu-test-XXXXXX";
+    int fd = mkstemp(fileName);
+
+    if (fd < 0 || write(fd, wait_rom, sizeof(wait_rom)) != sizeof(wait_rom))
+    {
+        perror("Failed to write test ROM.\n");
+        return 1;
+    }
+
+    close(fd);
+
+    uint8 error = test_suspended_done(fileName);
+    printf("vec env done while suspended: %s\n", error ? "FAIL" : "ok");
+
+    unlink(fileName);
+
+    return error;
+}
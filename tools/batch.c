@@ -0,0 +1,863 @@
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chip/chip.h>
+#include <chip/chip_aot.h>
+#include <chip/chip_loop.h>
+#include <chip/chip_pack.h>
+#include <chip/chip_pool.h>
+#include <chip/chip_quirks.h>
+#include <chip/chip_ring.h>
+#include <chip/chip_sink.h>
+#include <chip/chip_tailcall.h>
+#include <chip/chip_tier.h>
+
+// why a rom stopped
+enum batch_reason
+{
+    BATCH_ERROR,
+    BATCH_FRAMES,
+    BATCH_BUDGET,
+    BATCH_UNTIL,
+    BATCH_LOOP,
+    BATCH_CRASH,
+};
+
+static const char *batch_reason_name[] = {"error", "frames", "budget", "until", "loop", "crash"};
+
+// columns of the -o result file, in the order of the text output
+static const chip_sink_column batch_column[] = {
+    {"index", CHIP_SINK_U64},  {"rom", CHIP_SINK_TEXT},          {"reason", CHIP_SINK_U8}, {"loop", CHIP_SINK_U64},
+    {"frames", CHIP_SINK_U64}, {"instructions", CHIP_SINK_U64}, {"hash", CHIP_SINK_U64},  {"nanos", CHIP_SINK_U64},
+    {"quirks", CHIP_SINK_U8},
+};
+
+// a rom on disk, or served from an archive when data is set
+typedef struct batch_rom
+{
+    char *path;
+    const uint8 *data;
+    uint32 size;
+} batch_rom;
+
+// rom list
+typedef struct batch_list
+{
+    batch_rom *rom;
+    uint32 count;
+    uint32 size;
+} batch_list;
+
+// outcome of one rom
+typedef struct batch_result
+{
+    uint8 reason;
+    uint64 loop;
+    uint64 frames;
+    uint64 cycles;
+    uint64 hash;
+    uint64 nanos;
+
+    // quirks the rom ran with, and the hash of its bytes they were chosen for
+    uint8 quirks;
+    uint64 rom_hash;
+} batch_result;
+
+// work done by one thread, on its own cache line
+typedef struct batch_worker
+{
+    uint64 roms;
+    uint64 cycles;
+} __attribute__((aligned(64))) batch_worker;
+
+typedef struct batch_job
+{
+    batch_list roms;
+
+    // results kept for the text output, or rows appended to the result file
+    batch_result *result;
+    chip_sink *sink;
+
+    // set when a row could not be appended: the result file misses it and the batch fails
+    uint8 failed;
+
+    uint64 frames;
+    uint64 budget;
+    uint64 seed;
+    uint8 loops;
+    uint8 (*until)();
+
+    // quirks every rom runs with, or detected per rom and kept in the cache when detect is set
+    uint8 quirks;
+    uint8 detect;
+    chip_quirk_cache *cache;
+
+    // directory of cached native translations, 0 to interpret
+    const char *translations;
+
+    // start every rom on the interpreter and compile what gets hot, natively only with translations
+    uint8 tiered;
+
+    // interpret with the tail-call interpreter instead of util_chip_execute
+    uint8 tailcall;
+
+    // pin threads to CPUs, and what every thread of the pool did
+    uint8 pin;
+    batch_worker *worker;
+} batch_job;
+
+// no rom running on a worker thread
+#define BATCH_IDLE (~0ULL)
+
+// result sent from a worker process to the parent
+typedef struct batch_record
+{
+    uint32 index;
+    batch_result result;
+} batch_record;
+
+// mapped before forking, shared by the parent and every worker process
+typedef struct batch_shared
+{
+    // next rom to claim
+    uint64 next;
+
+    // rom run by every thread of every process, BATCH_IDLE when none
+    uint64 current[];
+} batch_shared;
+
+// a worker process and its slot in the shared mapping
+typedef struct batch_shard
+{
+    batch_job *job;
+    batch_shared *shared;
+    uint64 *current;
+    uint32 threads;
+
+    // results on their way to the parent, pushed by one thread at a time
+    chip_ring *ring;
+    pthread_mutex_t lock;
+
+    cpu_set_t cpus;
+    pid_t pid;
+} batch_shard;
+
+uint8 batch_add(batch_list *, const char *);
+uint8 batch_add_dir(batch_list *, const char *);
+uint8 batch_add_pack(batch_list *, const char *);
+uint8 batch_until_halt();
+uint8 batch_until_keywait();
+void batch_run(batch_job *, uint32, batch_result *);
+void batch_emit(batch_job *, uint32, uint32, const batch_result *);
+void batch_task(uint32, void *);
+void batch_report(const batch_job *, chip_pool *, uint64);
+uint8 batch_fork(batch_job *, uint32, uint32);
+uint8 batch_spawn(batch_shard *);
+void batch_shard_task(uint32, void *);
+uint32 batch_drain(batch_shard *, uint8 *);
+uint64 batch_now();
+void batch_usage();
+
+int main(int argc, char **argv)
+{
+    batch_job job = {.frames = 600, .loops = 1};
+    uint32 threads = 0;
+    uint32 processes = 0;
+    const char *output = 0;
+    const char *cache = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:P:af:b:r:u:o:q:c:t:TILh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            threads = strtoul(optarg, 0, 10);
+            break;
+        case 'P':
+            processes = strtoul(optarg, 0, 10);
+            break;
+        case 'a':
+            job.pin = 1;
+            break;
+        case 'f':
+            job.frames = strtoull(optarg, 0, 10);
+            break;
+        case 'b':
+            job.budget = strtoull(optarg, 0, 10);
+            break;
+        case 'r':
+            job.seed = strtoull(optarg, 0, 10);
+            break;
+        case 'L':
+            job.loops = 0;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'q':
+            if (strcmp(optarg, "auto") == 0)
+                job.detect = 1;
+            else if (util_quirks_parse(optarg, &job.quirks))
+                return 1;
+            break;
+        case 'c':
+            cache = optarg;
+            break;
+        case 't':
+            job.translations = optarg;
+            break;
+        case 'T':
+            job.tiered = 1;
+            break;
+        case 'I':
+            job.tailcall = 1;
+            break;
+        case 'u':
+            if (strcmp(optarg, "halt") == 0)
+                job.until = batch_until_halt;
+            else if (strcmp(optarg, "keywait") == 0)
+                job.until = batch_until_keywait;
+            else
+            {
+                batch_usage();
+                return 1;
+            }
+            break;
+        default:
+            batch_usage();
+            return 1;
+        }
+    }
+
+    for (int i = optind; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-") == 0)
+        {
+            // read rom paths from stdin, one per line
+            char line[4096];
+            while (fgets(line, sizeof(line), stdin))
+            {
+                line[strcspn(line, "\r\n")] = 0;
+                if (line[0] && batch_add(&job.roms, line))
+                    return 1;
+            }
+            continue;
+        }
+
+        struct stat info;
+        size_t length = strlen(argv[i]);
+
+        if (stat(argv[i], &info) == 0 && S_ISDIR(info.st_mode))
+        {
+            if (batch_add_dir(&job.roms, argv[i]))
+                return 1;
+        }
+        else if (length > 5 && strcmp(argv[i] + length - 5, ".c8pk") == 0)
+        {
+            if (batch_add_pack(&job.roms, argv[i]))
+                return 1;
+        }
+        else if (batch_add(&job.roms, argv[i]))
+            return 1;
+    }
+
+    if (job.roms.count == 0)
+    {
+        batch_usage();
+        return 1;
+    }
+
+    // worker processes only read the cache: their decisions come back with their results
+    if (job.detect && cache && (job.cache = util_quirk_cache_open(cache)) == 0)
+        return 1;
+
+    // worker processes start their own pools: threads do not survive fork
+    chip_pool *pool = 0;
+
+    if (processes == 0)
+    {
+        pool = util_pool_create(threads, job.pin);
+        job.worker = pool ? aligned_alloc(64, util_pool_threads(pool) * sizeof(batch_worker)) : 0;
+
+        if (job.worker == 0)
+            return 1;
+
+        memset(job.worker, 0, util_pool_threads(pool) * sizeof(batch_worker));
+    }
+
+    if (output)
+    {
+        job.sink = util_sink_create(output, batch_column, sizeof(batch_column) / sizeof(batch_column[0]), pool ? util_pool_threads(pool) : 1);
+
+        if (job.sink == 0)
+            return 1;
+    }
+    else if ((job.result = calloc(job.roms.count, sizeof(batch_result))) == 0)
+    {
+        fprintf(stderr, "Error while starting batch: out of memory\n");
+        return 1;
+    }
+
+    if (pool)
+    {
+        uint64 start = batch_now();
+        util_pool_run(pool, job.roms.count, batch_task, &job);
+
+        if (job.pin)
+            batch_report(&job, pool, batch_now() - start);
+
+        util_pool_destroy(pool);
+    }
+    else if (batch_fork(&job, processes, threads))
+        return 1;
+
+    if (job.cache && util_quirk_cache_close(job.cache))
+        return 1;
+
+    if (output)
+        return util_sink_close(job.sink) || job.failed;
+
+    printf("rom\treason\tloop\tframes\tinstructions\thash\tnanos\tquirks\n");
+    for (uint32 i = 0; i < job.roms.count; i++)
+    {
+        batch_result *result = &job.result[i];
+
+        if (result->reason == BATCH_ERROR || result->reason == BATCH_CRASH)
+            printf("%s\t%s\n", job.roms.rom[i].path, batch_reason_name[result->reason]);
+        else
+            printf("%s\t%s\t%llu\t%llu\t%llu\t%016llx\t%llu\t%02x\n", job.roms.rom[i].path, batch_reason_name[result->reason], result->loop,
+                   result->frames, result->cycles, result->hash, result->nanos, result->quirks);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Append a rom path to the list
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 batch_add(batch_list *list, const char *path)
+{
+    if (list->count == list->size)
+    {
+        uint32 size = list->size ? list->size * 2 : 64;
+        batch_rom *grown = realloc(list->rom, size * sizeof(batch_rom));
+
+        if (grown == 0)
+        {
+            fprintf(stderr, "Error while listing ROMs: out of memory\n");
+            return 1;
+        }
+
+        list->rom = grown;
+        list->size = size;
+    }
+
+    list->rom[list->count] = (batch_rom){.path = strdup(path)};
+
+    if (list->rom[list->count].path == 0)
+    {
+        fprintf(stderr, "Error while listing ROMs: out of memory\n");
+        return 1;
+    }
+
+    list->count++;
+    return 0;
+}
+
+static int batch_compare(const void *a, const void *b)
+{
+    return strcmp(((const batch_rom *)a)->path, ((const batch_rom *)b)->path);
+}
+
+/**
+ * @brief Append every .ch8 file of a directory to the list, sorted by name
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 batch_add_dir(batch_list *list, const char *dir)
+{
+    DIR *handle = opendir(dir);
+
+    if (handle == 0)
+    {
+        perror("Failed to open ROM directory.\n");
+        return 1;
+    }
+
+    uint32 first = list->count;
+    struct dirent *entry;
+
+    while ((entry = readdir(handle)))
+    {
+        size_t length = strlen(entry->d_name);
+
+        if (length < 4 || strcmp(entry->d_name + length - 4, ".ch8"))
+            continue;
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+
+        if (batch_add(list, path))
+        {
+            closedir(handle);
+            return 1;
+        }
+    }
+
+    closedir(handle);
+
+    qsort(list->rom + first, list->count - first, sizeof(batch_rom), batch_compare);
+    return 0;
+}
+
+/**
+ * @brief Append every ROM of an archive to the list, in name order
+ *
+ * The archive stays mapped until the batch exits: its ROMs are loaded straight from the mapping.
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 batch_add_pack(batch_list *list, const char *fileName)
+{
+    chip_pack *pack = util_pack_open(fileName);
+
+    if (pack == 0)
+        return 1;
+
+    for (uint32 i = 0; i < pack->count; i++)
+    {
+        chip_rom rom;
+        char path[4096];
+
+        util_pack_entry(pack, util_pack_read(pack->by_name + (uint64)i * 4, 4), &rom);
+        snprintf(path, sizeof(path), "%s:%s", fileName, rom.name);
+
+        if (batch_add(list, path))
+            return 1;
+
+        list->rom[list->count - 1].data = rom.data;
+        list->rom[list->count - 1].size = rom.size;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Stop when the running chip jumps to itself
+ */
+uint8 batch_until_halt()
+{
+    uint16 opcode = (chip->memory[chip->PC & 0xFFF] << 8) + chip->memory[(chip->PC & 0xFFF) + 1];
+
+    return opcode == (0x1000 | chip->PC);
+}
+
+/**
+ * @brief Stop when the running chip waits for a key (Fx0A)
+ */
+uint8 batch_until_keywait()
+{
+    uint16 opcode = (chip->memory[chip->PC & 0xFFF] << 8) + chip->memory[(chip->PC & 0xFFF) + 1];
+
+    return (opcode & 0xF0FF) == 0xF00A;
+}
+
+/**
+ * @brief Keep a rom's result for the text output, or append it to the result file
+ *
+ * @param worker the sink buffer to append to
+ */
+void batch_emit(batch_job *job, uint32 worker, uint32 index, const batch_result *result)
+{
+    if (job->cache && result->reason != BATCH_ERROR && result->reason != BATCH_CRASH)
+        util_quirk_cache_put(job->cache, result->rom_hash, result->quirks);
+
+    if (job->result)
+    {
+        job->result[index] = *result;
+        return;
+    }
+
+    chip_sink_value row[] = {
+        {.number = index},          {.text = job->roms.rom[index].path}, {.number = result->reason}, {.number = result->loop},
+        {.number = result->frames}, {.number = result->cycles},          {.number = result->hash},   {.number = result->nanos},
+        {.number = result->quirks},
+    };
+
+    if (util_sink_append(job->sink, worker, row))
+        __atomic_store_n(&job->failed, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Run one rom of the job on the calling worker
+ */
+void batch_task(uint32 index, void *arg)
+{
+    batch_job *job = arg;
+    batch_result result = {0};
+
+    batch_run(job, index, &result);
+    batch_emit(job, util_pool_worker(), index, &result);
+
+    job->worker[util_pool_worker()].roms++;
+    job->worker[util_pool_worker()].cycles += result.cycles;
+}
+
+/**
+ * @brief Print the work done by the threads of every NUMA node to stderr
+ *
+ * @param nanos wall time of the run
+ */
+void batch_report(const batch_job *job, chip_pool *pool, uint64 nanos)
+{
+    uint32 threads = util_pool_threads(pool), nodes = 0;
+
+    for (uint32 w = 0; w < threads; w++)
+        if (util_pool_node(pool, w) >= nodes)
+            nodes = util_pool_node(pool, w) + 1;
+
+    fprintf(stderr, "node\tthreads\troms\tinstructions\tinstructions/s\n");
+
+    for (uint32 n = 0; n < nodes; n++)
+    {
+        batch_worker total = {0};
+        uint32 count = 0;
+
+        for (uint32 w = 0; w < threads; w++)
+            if (util_pool_node(pool, w) == n)
+            {
+                total.roms += job->worker[w].roms;
+                total.cycles += job->worker[w].cycles;
+                count++;
+            }
+
+        if (count)
+            fprintf(stderr, "%lu\t%lu\t%llu\t%llu\t%.0f\n", n, count, total.roms, total.cycles, total.cycles * 1e9 / (nanos ? nanos : 1));
+    }
+}
+
+/**
+ * @brief Run the job on worker processes, each pinned to its share of the CPUs
+ *
+ * Processes claim roms from a shared counter and send results back through
+ * their own shared-memory ring. A process killed by a rom is started again;
+ * the roms it was running are reported as crashed.
+ *
+ * @param processes number of worker processes
+ * @param threads threads in every process, 0 for one per CPU of its share
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 batch_fork(batch_job *job, uint32 processes, uint32 threads)
+{
+    cpu_set_t online;
+    uint32 cpu[CPU_SETSIZE], cpus = 0;
+
+    sched_getaffinity(0, sizeof(online), &online);
+    for (uint32 c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &online))
+            cpu[cpus++] = c;
+
+    if (threads == 0)
+        threads = cpus > processes ? (cpus + processes - 1) / processes : 1;
+
+    uint64 size = sizeof(batch_shared) + (uint64)processes * threads * sizeof(uint64);
+    batch_shared *shared = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    batch_shard *shard = calloc(processes, sizeof(batch_shard));
+    uint8 *reported = calloc(job->roms.count / 8 + 1, 1);
+
+    if (shared == MAP_FAILED || shard == 0 || reported == 0)
+    {
+        fprintf(stderr, "Error while starting worker processes: out of memory\n");
+        return 1;
+    }
+
+    for (uint64 t = 0; t < (uint64)processes * threads; t++)
+        shared->current[t] = BATCH_IDLE;
+
+    for (uint32 k = 0; k < processes; k++)
+    {
+        batch_shard *s = &shard[k];
+
+        s->job = job;
+        s->shared = shared;
+        s->current = shared->current + (uint64)k * threads;
+        s->threads = threads;
+        pthread_mutex_init(&s->lock, 0);
+
+        // contiguous CPUs per process, or one CPU each when there are more processes than CPUs
+        CPU_ZERO(&s->cpus);
+        for (uint32 c = 0; c < cpus; c++)
+            if ((uint64)c * processes / cpus == k || (processes > cpus && c == k % cpus))
+                CPU_SET(cpu[c], &s->cpus);
+
+        if ((s->ring = util_ring_create(0x400, sizeof(batch_record))) == 0 || batch_spawn(s))
+            return 1;
+    }
+
+    uint32 alive = processes;
+
+    while (alive)
+    {
+        uint32 drained = 0;
+
+        for (uint32 k = 0; k < processes; k++)
+            drained += batch_drain(&shard[k], reported);
+
+        int status;
+        pid_t pid;
+
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+        {
+            batch_shard *s = shard;
+            while (s->pid != pid)
+                s++;
+
+            batch_drain(s, reported);
+
+            if (WIFSIGNALED(status))
+            {
+                // a thread killed between sending its result and going idle did not crash on that rom
+                for (uint32 t = 0; t < threads; t++)
+                {
+                    uint64 i = s->current[t];
+                    s->current[t] = BATCH_IDLE;
+
+                    if (i != BATCH_IDLE && !(reported[i / 8] >> (i % 8) & 1))
+                        fprintf(stderr, "%s: worker process killed by signal %d\n", job->roms.rom[i].path, WTERMSIG(status));
+                }
+
+                util_ring_reset(s->ring);
+
+                if (__atomic_load_n(&shared->next, __ATOMIC_RELAXED) < job->roms.count && batch_spawn(s) == 0)
+                    continue;
+            }
+
+            alive--;
+        }
+
+        if (drained == 0)
+            nanosleep(&(struct timespec){.tv_nsec = 100000}, 0);
+    }
+
+    // roms claimed by a process that died, or never claimed at all
+    for (uint32 i = 0; i < job->roms.count; i++)
+        if (!(reported[i / 8] >> (i % 8) & 1))
+            batch_emit(job, 0, i, &(batch_result){.reason = BATCH_CRASH});
+
+    for (uint32 k = 0; k < processes; k++)
+        util_ring_destroy(shard[k].ring);
+
+    munmap(shared, size);
+    free(shard);
+    free(reported);
+
+    return 0;
+}
+
+/**
+ * @brief Start a worker process on the shard's CPUs
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 batch_spawn(batch_shard *shard)
+{
+    shard->pid = fork();
+
+    if (shard->pid < 0)
+    {
+        perror("Failed to start worker process.\n");
+        return 1;
+    }
+
+    if (shard->pid)
+        return 0;
+
+    sched_setaffinity(0, sizeof(shard->cpus), &shard->cpus);
+
+    chip_pool *pool = util_pool_create(shard->threads, shard->job->pin);
+
+    if (pool == 0)
+        _exit(1);
+
+    util_pool_run(pool, shard->threads, batch_shard_task, shard);
+    _exit(0);
+}
+
+/**
+ * @brief Claim and run roms until none is left, on a thread of a worker process
+ *
+ * @param index the thread's slot in the shard
+ */
+void batch_shard_task(uint32 index, void *arg)
+{
+    batch_shard *shard = arg;
+    batch_job *job = shard->job;
+    uint64 i;
+
+    while ((i = __atomic_fetch_add(&shard->shared->next, 1, __ATOMIC_RELAXED)) < job->roms.count)
+    {
+        batch_record record = {.index = i};
+
+        __atomic_store_n(&shard->current[index], i, __ATOMIC_RELAXED);
+        batch_run(job, i, &record.result);
+
+        pthread_mutex_lock(&shard->lock);
+        while (util_ring_push(shard->ring, &record))
+            sched_yield();
+        pthread_mutex_unlock(&shard->lock);
+
+        __atomic_store_n(&shard->current[index], BATCH_IDLE, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Emit every result a worker process has sent so far
+ *
+ * @return the number of results
+ */
+uint32 batch_drain(batch_shard *shard, uint8 *reported)
+{
+    batch_record record;
+    uint32 count = 0;
+
+    while (util_ring_pop(shard->ring, &record) == 0)
+    {
+        batch_emit(shard->job, 0, record.index, &record.result);
+        reported[record.index / 8] |= 1 << (record.index % 8);
+        count++;
+    }
+
+    return count;
+}
+
+/**
+ * @brief Run one rom of the job until it stops
+ */
+void batch_run(batch_job *job, uint32 index, batch_result *result)
+{
+    chip_state machine;
+    batch_rom *rom = &job->roms.rom[index];
+    const uint8 *data = rom->data;
+    uint32 size = rom->size;
+    uint8 bytes[CHIP_MEMORY_SIZE - 0x200];
+
+    if (data == 0)
+    {
+        if (util_chip_read_ROM(rom->path, bytes, &size))
+        {
+            result->reason = BATCH_ERROR;
+            return;
+        }
+
+        data = bytes;
+    }
+
+    result->quirks = job->quirks;
+
+    if (job->detect)
+    {
+        result->rom_hash = util_chip_hash(data, size);
+
+        // the pool is busy running roms: the profiles of this one run on this thread
+        if (job->cache == 0 || util_quirk_cache_get(job->cache, result->rom_hash, &result->quirks) == 0)
+            result->quirks = util_quirks_detect(data, size, CHIP_QUIRKS_FRAMES, 0, 0);
+    }
+
+    chip = &machine;
+    util_chip_init();
+    util_chip_load_ROM_bytes(data, size);
+    chip->seed = job->seed;
+    chip->quirks = result->quirks;
+
+    chip_aot *aot = 0;
+    chip_tier *tier = 0;
+
+    if (job->tiered ? (tier = util_tier_create(data, size, job->translations)) == 0
+                    : job->translations && (aot = util_aot_open(job->translations, data, size)) == 0)
+    {
+        result->reason = BATCH_ERROR;
+        return;
+    }
+
+    void (*frame)() = aot ? aot->frame : job->tailcall ? util_tailcall_frame : util_chip_frame;
+
+    // the detector holds a whole machine: keep it off the worker's stack
+    static _Thread_local chip_loop loop;
+    util_loop_init(&loop, chip);
+
+    uint64 start = batch_now();
+
+    for (;;)
+    {
+        if (result->frames >= job->frames)
+        {
+            result->reason = BATCH_FRAMES;
+            break;
+        }
+
+        if (job->budget && chip->cycles >= job->budget)
+        {
+            result->reason = BATCH_BUDGET;
+            break;
+        }
+
+        if (job->until && job->until())
+        {
+            result->reason = BATCH_UNTIL;
+            break;
+        }
+
+        if (tier)
+            util_tier_frame(tier);
+        else
+            frame();
+
+        result->frames++;
+
+        if (job->loops && (result->loop = util_loop_check(&loop, chip)))
+        {
+            result->reason = BATCH_LOOP;
+            break;
+        }
+    }
+
+    result->nanos = batch_now() - start;
+    result->cycles = chip->cycles;
+    result->hash = util_chip_hash(chip->display, sizeof(chip->display));
+
+    if (aot)
+        util_aot_close(aot);
+
+    if (tier)
+        util_tier_destroy(tier);
+}
+
+/**
+ * @brief Monotonic clock in nanoseconds
+ */
+uint64 batch_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void batch_usage()
+{
+    fprintf(stderr, "usage: chipEmu-batch [-j threads] [-P processes] [-a] [-f frames] [-b instructions] [-r seed] [-u halt|keywait] [-q auto|PROFILE] [-c quirks.cache] [-t translations/] [-T] [-I] [-L] [-o results.c8rs] ROM|DIR|ARCHIVE|- ...\n");
+}
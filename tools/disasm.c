@@ -0,0 +1,140 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <chip/chip.h>
+#include <chip/chip_analysis.h>
+
+void disasm_listing(const chip_analysis *);
+void disasm_calls(const chip_analysis *);
+void disasm_usage();
+
+int main(int argc, char **argv)
+{
+    uint8 summary = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "sh")) != -1)
+    {
+        switch (opt)
+        {
+        case 's':
+            summary = 1;
+            break;
+        default:
+            disasm_usage();
+            return 1;
+        }
+    }
+
+    if (optind == argc)
+    {
+        disasm_usage();
+        return 1;
+    }
+
+    static uint8 bytes[0x1000 - 0x200];
+    static chip_analysis rom;
+    uint8 error = 0;
+
+    for (int i = optind; i < argc; i++)
+    {
+        uint32 size;
+
+        if (util_chip_read_ROM(argv[i], bytes, &size))
+        {
+            error = 1;
+            continue;
+        }
+
+        util_analysis_walk(&rom, bytes, size);
+
+        printf("; %s: %lu bytes, %lu blocks, %lu instructions, %lu subroutines, %lu indirect jumps, %lu overlapping addresses\n", argv[i], rom.size,
+               rom.blocks, rom.instructions, rom.subroutines, rom.indirect, rom.overlaps);
+
+        if (!summary)
+            disasm_listing(&rom);
+
+        disasm_calls(&rom);
+        printf("\n");
+    }
+
+    return error;
+}
+
+/**
+ * @brief Print the ROM: reached instructions under the label of their block, the rest as bytes
+ */
+void disasm_listing(const chip_analysis *rom)
+{
+    uint16 end = 0x200 + rom->size;
+
+    for (uint16 addr = 0x200; addr < end;)
+    {
+        uint8 flags = rom->addr[addr];
+
+        if (flags & (CHIP_ADDR_LEADER | CHIP_ADDR_DATA))
+            printf("\n%s_%03X:\n", flags & CHIP_ADDR_SUBROUTINE ? "sub" : flags & CHIP_ADDR_LEADER ? "block" : "data", addr);
+
+        if (flags & CHIP_ADDR_CODE)
+        {
+            uint16 opcode = util_analysis_opcode(rom, addr);
+            char text[32];
+            const char *note = flags & CHIP_ADDR_INDIRECT                                            ? "indirect jump"
+                               : !util_analysis_overlap(rom, addr) && !util_analysis_overlap(rom, addr + 1) ? 0
+                               : rom->addr[addr + 1] & CHIP_ADDR_CODE || rom->addr[addr] & CHIP_ADDR_OPERAND ? "overlaps another instruction"
+                                                                                                         : "overlaps data";
+
+            util_analysis_mnemonic(opcode, text, sizeof(text));
+
+            if (note)
+                printf("    %03X: %04X  %-20s ; %s\n", addr, opcode, text, note);
+            else
+                printf("    %03X: %04X  %s\n", addr, opcode, text);
+
+            // an instruction starting in this one is listed too
+            addr += rom->addr[addr + 1] & CHIP_ADDR_CODE ? 1 : 2;
+            continue;
+        }
+
+        // bytes no control flow reaches, up to 8 a line
+        printf("    %03X: DB", addr);
+
+        uint16 start = addr;
+
+        do
+            printf(" 0x%02X", rom->bytes[addr - 0x200]), addr++;
+        while (addr < end && addr - start < 8 && !(rom->addr[addr] & (CHIP_ADDR_CODE | CHIP_ADDR_LEADER | CHIP_ADDR_DATA)));
+
+        printf("\n");
+    }
+}
+
+/**
+ * @brief Print every subroutine with the addresses calling it
+ */
+void disasm_calls(const chip_analysis *rom)
+{
+    if (rom->calls == 0)
+        return;
+
+    printf("\n; call graph\n");
+
+    for (uint32 addr = 0; addr < 0x1000; addr++)
+    {
+        if (!(rom->addr[addr] & CHIP_ADDR_SUBROUTINE))
+            continue;
+
+        printf(";   sub_%03lX <-", addr);
+
+        for (uint32 i = 0; i < rom->calls; i++)
+            if (rom->call[i].to == addr)
+                printf(" %03X", rom->call[i].from);
+
+        printf("\n");
+    }
+}
+
+void disasm_usage()
+{
+    fprintf(stderr, "usage: chipEmu-disasm [-s] ROM ...\n");
+}
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chip/chip.h>
+#include <chip/chip_fork.h>
+#include <chip/chip_pool.h>
+#include <chip/chip_seen.h>
+
+// a state reached by holding action's keys from its parent
+typedef struct explore_node
+{
+    chip_fork *fork;
+    uint32 parent;
+    uint8 action;
+} explore_node;
+
+typedef struct explore_level
+{
+    explore_node *node;
+    uint32 count;
+    uint32 size;
+} explore_level;
+
+typedef struct explore
+{
+    // key masks tried from every state
+    uint16 action[0x11];
+    uint8 actions;
+
+    // frames every action is held for
+    uint32 frames;
+
+    // stop at the first state with this PC, 0 to explore everything
+    uint16 goal;
+    uint8 found;
+    uint32 found_worker;
+    uint32 found_index;
+
+    chip_seen *seen;
+    chip_fork_host *host;
+
+    // levels[depth] is being expanded, into out[worker]
+    explore_level *levels;
+    uint32 depth;
+    explore_level *out;
+
+    uint64 steps;
+
+    // set by a worker that ran out of memory: the search stops
+    uint8 failed;
+} explore;
+
+uint8 explore_push(explore_level *, explore_node);
+void explore_task(uint32, void *);
+void explore_path(explore *, uint32, uint32);
+uint64 explore_now();
+void explore_usage();
+
+int main(int argc, char **argv)
+{
+    explore ex = {.frames = 4};
+    uint32 threads = 0;
+    uint32 max_depth = 64;
+    uint64 capacity = 1 << 22;
+    const char *keys = "0123456789abcdef";
+    uint64 seed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:s:d:n:k:p:r:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            threads = strtoul(optarg, 0, 10);
+            break;
+        case 's':
+            ex.frames = strtoul(optarg, 0, 10);
+            break;
+        case 'd':
+            max_depth = strtoul(optarg, 0, 10);
+            break;
+        case 'n':
+            capacity = strtoull(optarg, 0, 10);
+            break;
+        case 'k':
+            keys = optarg;
+            break;
+        case 'p':
+            ex.goal = strtoul(optarg, 0, 16);
+            break;
+        case 'r':
+            seed = strtoull(optarg, 0, 10);
+            break;
+        default:
+            explore_usage();
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        explore_usage();
+        return 1;
+    }
+
+    // no key, then every key on its own
+    ex.action[ex.actions++] = 0;
+    for (const char *k = keys; *k && ex.actions < 0x11; k++)
+    {
+        char digit[2] = {*k, 0};
+        char *end;
+        uint16 key = strtoul(digit, &end, 16);
+
+        if (*end)
+        {
+            explore_usage();
+            return 1;
+        }
+
+        ex.action[ex.actions++] = 1 << key;
+    }
+
+    util_chip_init();
+    chip->seed = seed;
+    if (util_chip_load_ROM(argv[optind]))
+        return 1;
+
+    chip_pool *pool = util_pool_create(threads, 0);
+    threads = pool ? util_pool_threads(pool) : 0;
+
+    ex.seen = util_seen_create(capacity);
+    ex.host = aligned_alloc(64, threads * sizeof(chip_fork_host));
+    ex.out = calloc(threads, sizeof(explore_level));
+    ex.levels = calloc(max_depth + 1, sizeof(explore_level));
+
+    if (pool == 0 || ex.seen == 0 || ex.host == 0 || ex.out == 0 || ex.levels == 0)
+    {
+        fprintf(stderr, "Error while starting exploration: out of memory\n");
+        return 1;
+    }
+
+    memset(ex.host, 0, threads * sizeof(chip_fork_host));
+
+    explore_node root = {.fork = util_fork_capture(chip)};
+    if (root.fork == 0)
+        return 1;
+
+    util_seen_insert(ex.seen, util_fork_hash(root.fork));
+    explore_push(&ex.levels[0], root);
+
+    printf("depth\tfrontier\tnew\tseen\tsteps/s\tstates/s\n");
+
+    uint64 start = explore_now();
+
+    for (ex.depth = 0; ex.depth < max_depth && ex.levels[ex.depth].count && !ex.found; ex.depth++)
+    {
+        explore_level *level = &ex.levels[ex.depth];
+        explore_level *next = &ex.levels[ex.depth + 1];
+        uint64 steps = ex.steps;
+        uint64 level_start = explore_now();
+
+        util_pool_run(pool, level->count, explore_task, &ex);
+
+        if (ex.failed)
+            return 1;
+
+        uint64 nanos = explore_now() - level_start;
+
+        for (uint32 w = 0; w < threads; w++)
+        {
+            if (ex.found && ex.found_worker == w)
+                ex.found_index += next->count;
+
+            for (uint32 i = 0; i < ex.out[w].count; i++)
+                if (explore_push(next, ex.out[w].node[i]))
+                    return 1;
+
+            ex.out[w].count = 0;
+        }
+
+        for (uint32 i = 0; i < level->count; i++)
+        {
+            util_fork_release(level->node[i].fork);
+            level->node[i].fork = 0;
+        }
+
+        printf("%lu\t%lu\t%lu\t%llu\t%.0f\t%.0f\n", ex.depth + 1, level->count, next->count, ex.seen->count,
+               (ex.steps - steps) * 1e9 / (nanos ? nanos : 1), next->count * 1e9 / (nanos ? nanos : 1));
+    }
+
+    uint64 nanos = explore_now() - start;
+
+    printf("total\t%llu states in %.3f s, %.0f states/s, %.0f steps/s\n", ex.seen->count, nanos / 1e9,
+           ex.seen->count * 1e9 / (nanos ? nanos : 1), ex.steps * 1e9 / (nanos ? nanos : 1));
+
+    if (ex.seen->full)
+        printf("state table full: raise -n to explore further\n");
+
+    if (ex.goal)
+    {
+        if (ex.found)
+            explore_path(&ex, ex.depth, ex.found_index);
+        else
+            printf("PC %03x not reached\n", ex.goal);
+    }
+
+    util_pool_destroy(pool);
+    util_seen_destroy(ex.seen);
+
+    return 0;
+}
+
+/**
+ * @brief Append a node to a level
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 explore_push(explore_level *level, explore_node node)
+{
+    if (level->count == level->size)
+    {
+        uint32 size = level->size ? level->size * 2 : 256;
+        explore_node *grown = realloc(level->node, size * sizeof(explore_node));
+
+        if (grown == 0)
+        {
+            fprintf(stderr, "Error while exploring: out of memory\n");
+            return 1;
+        }
+
+        level->node = grown;
+        level->size = size;
+    }
+
+    level->node[level->count++] = node;
+    return 0;
+}
+
+/**
+ * @brief Try every action from one state of the level being expanded
+ */
+void explore_task(uint32 index, void *arg)
+{
+    explore *ex = arg;
+    uint32 worker = util_pool_worker();
+    chip_fork_host *host = &ex->host[worker];
+    explore_level *out = &ex->out[worker];
+    chip_fork *parent = ex->levels[ex->depth].node[index].fork;
+
+    chip = &host->machine;
+
+    for (uint8 a = 0; a < ex->actions && !__atomic_load_n(&ex->failed, __ATOMIC_RELAXED); a++)
+    {
+        util_fork_enter(host, parent);
+
+        for (uint8 k = 0; k < 0x10; k++)
+            chip->key_state[k] = (ex->action[a] >> k) & 1;
+
+        for (uint32 f = 0; f < ex->frames; f++)
+            util_chip_frame();
+
+        chip_fork *child = util_fork_commit(host, parent);
+
+        if (child == 0)
+        {
+            __atomic_store_n(&ex->failed, 1, __ATOMIC_RELAXED);
+            return;
+        }
+
+        if (!util_seen_insert(ex->seen, util_fork_hash(child)))
+        {
+            util_fork_release(child);
+            continue;
+        }
+
+        if (explore_push(out, (explore_node){.fork = child, .parent = index, .action = a}))
+        {
+            util_fork_release(child);
+            __atomic_store_n(&ex->failed, 1, __ATOMIC_RELAXED);
+            return;
+        }
+
+        if (ex->goal && child->PC == ex->goal && !__atomic_exchange_n(&ex->found, 1, __ATOMIC_RELAXED))
+        {
+            ex->found_worker = worker;
+            ex->found_index = out->count - 1;
+        }
+    }
+
+    __atomic_add_fetch(&ex->steps, ex->actions, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Print the actions leading to a node, from the start state
+ */
+void explore_path(explore *ex, uint32 depth, uint32 index)
+{
+    printf("PC %03x reached after %lu steps:", ex->goal, depth);
+
+    uint8 *actions = malloc(depth + 1);
+    for (uint32 d = depth; d > 0; d--)
+    {
+        explore_node *node = &ex->levels[d].node[index];
+        actions[d] = node->action;
+        index = node->parent;
+    }
+
+    for (uint32 d = 1; d <= depth; d++)
+    {
+        uint16 mask = ex->action[actions[d]];
+
+        if (mask == 0)
+            printf(" -");
+        else
+            for (uint8 k = 0; k < 0x10; k++)
+                if (mask == 1 << k)
+                    printf(" %x", k);
+    }
+
+    printf("\n");
+    free(actions);
+}
+
+/**
+ * @brief Monotonic clock in nanoseconds
+ */
+uint64 explore_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void explore_usage()
+{
+    fprintf(stderr, "usage: chipEmu-explore [-j threads] [-s frames per step] [-d depth] [-n states] [-k keys] [-p PC] [-r seed] ROM\n");
+}
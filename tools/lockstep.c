@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chip/chip.h>
+#include <chip/chip_cpu.h>
+#include <chip/chip_lockstep.h>
+
+uint64 lockstep_now();
+chip_lockstep *lockstep_run(const chip_state *, uint32, uint64, uint32, uint64 *);
+void lockstep_vary(chip_state *, uint32);
+void lockstep_usage();
+
+int main(int argc, char **argv)
+{
+    uint32 lanes = 1024;
+    uint64 frames = 600;
+    uint8 alone = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:k:1h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            lanes = strtoul(optarg, 0, 10);
+            break;
+        case 'f':
+            frames = strtoull(optarg, 0, 10);
+            break;
+        case 'k':
+            if (util_cpu_force(optarg))
+                return 1;
+            break;
+        case '1':
+            alone = 1;
+            break;
+        default:
+            lockstep_usage();
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1 || lanes == 0)
+    {
+        lockstep_usage();
+        return 1;
+    }
+
+    static chip_state image;
+    util_chip_init();
+    if (util_chip_load_ROM(argv[optind]))
+        return 1;
+    util_chip_snapshot(&image);
+
+    uint64 lockstep_nanos;
+    chip_lockstep *ls = lockstep_run(&image, lanes, frames, alone ? 1 : lanes, &lockstep_nanos);
+    if (ls == 0)
+        return 1;
+
+    // the same machines run one after the other on the interpreter
+    uint32 mismatches = 0;
+    uint64 scalar_nanos = 0, start;
+
+    for (uint32 lane = 0; lane < lanes; lane++)
+    {
+        util_chip_restore(&image);
+        if (!alone || lane == 0)
+            lockstep_vary(chip, lane);
+
+        start = lockstep_now();
+        for (uint64 f = 0; f < frames; f++)
+            util_chip_frame();
+        scalar_nanos += lockstep_now() - start;
+
+        chip_state *machine = util_lockstep_machine(ls, lane);
+        if (memcmp(machine->display, chip->display, sizeof(chip->display)) || memcmp(machine->V, chip->V, sizeof(chip->V)) || machine->PC != chip->PC)
+            mismatches++;
+    }
+
+    double machine_frames = (double)lanes * frames;
+
+    // with lane 0 alone varied, the other lanes run as they do when no lane is: lane by lane only where that run does
+    uint8 held_back = 0;
+
+    if (alone)
+    {
+        uint64 nanos;
+        chip_lockstep *same = lockstep_run(&image, lanes, frames, 0, &nanos);
+        if (same == 0)
+            return 1;
+
+        held_back = ls->scalar > same->scalar - same->scalar / lanes + frames * CHIP_FRAME_CYCLES;
+        util_lockstep_destroy(same);
+    }
+
+    printf("lanes\t%lu\n", lanes);
+    printf("frames\t%llu\n", frames);
+    printf("kernel\t%s\n", util_cpu_name(ls->kernel));
+    printf("interpreter\t%.0f frames/s\n", machine_frames * 1e9 / (scalar_nanos ? scalar_nanos : 1));
+    printf("lockstep\t%.0f frames/s\n", machine_frames * 1e9 / (lockstep_nanos ? lockstep_nanos : 1));
+    printf("lane by lane\t%.2f%%\n", 100.0 * ls->scalar / machine_frames / CHIP_FRAME_CYCLES);
+    printf("mismatches\t%lu\n", mismatches);
+    if (alone)
+        printf("held back\t%s\n", held_back ? "yes" : "no");
+
+    util_lockstep_destroy(ls);
+
+    return mismatches != 0 || held_back;
+}
+
+/**
+ * @brief Run lanes copies of image in lockstep, the first varied ones differing by lockstep_vary
+ *
+ * @param image the machine every lane starts from
+ * @param lanes number of machines
+ * @param frames the frames to run
+ * @param varied number of lanes, from lane 0, passed to lockstep_vary
+ * @param nanos set to the run time
+ * @return the lockstep machines after the run, 0 if error occurred
+ */
+chip_lockstep *lockstep_run(const chip_state *image, uint32 lanes, uint64 frames, uint32 varied, uint64 *nanos)
+{
+    chip_lockstep *ls = util_lockstep_create(image, lanes);
+    if (ls == 0)
+        return 0;
+
+    for (uint32 lane = 0; lane < varied; lane++)
+    {
+        lockstep_vary(util_lockstep_machine(ls, lane), lane);
+        util_lockstep_store(ls, lane);
+    }
+
+    uint64 start = lockstep_now();
+    for (uint64 f = 0; f < frames; f++)
+        util_lockstep_frame(ls);
+    *nanos = lockstep_now() - start;
+
+    return ls;
+}
+
+/**
+ * @brief Make a lane differ from the others: its own random numbers, and a key held, if any, picked by lane
+ *
+ * Lanes then leave lockstep where the ROM reads keys or random numbers, so
+ * mixed vector and lane-by-lane execution is compared too.
+ */
+void lockstep_vary(chip_state *machine, uint32 lane)
+{
+    machine->seed ^= util_chip_hash(&lane, sizeof(lane));
+
+    if (lane % 0x11 < 0x10)
+        machine->key_state[lane % 0x11] = 1;
+}
+
+/**
+ * @brief Monotonic clock in nanoseconds
+ */
+uint64 lockstep_now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void lockstep_usage()
+{
+    fprintf(stderr, "usage: chipEmu-lockstep [-n lanes] [-f frames] [-k sse2|avx2|avx512] [-1] ROM\n");
+}
@@ -0,0 +1,307 @@
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <chip/chip.h>
+#include <chip/chip_pack.h>
+
+// a ROM read from disk
+typedef struct pack_rom
+{
+    char *name;
+    uint8 *data;
+    uint32 size;
+    uint64 hash;
+
+    // where its bytes land in the archive, shared with an identical ROM
+    uint32 offset;
+    uint8 shared;
+} pack_rom;
+
+typedef struct pack_list
+{
+    pack_rom *rom;
+    uint32 count;
+    uint32 size;
+} pack_list;
+
+uint8 pack_add(pack_list *, const char *, const char *);
+uint8 pack_add_dir(pack_list *, const char *);
+uint8 pack_write(pack_list *, const char *);
+void pack_usage();
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        pack_usage();
+        return 1;
+    }
+
+    pack_list list = {0};
+
+    for (int i = 2; i < argc; i++)
+    {
+        struct stat info;
+        if (stat(argv[i], &info) == 0 && S_ISDIR(info.st_mode))
+        {
+            if (pack_add_dir(&list, argv[i]))
+                return 1;
+        }
+        else
+        {
+            const char *name = strrchr(argv[i], '/');
+
+            if (pack_add(&list, argv[i], name ? name + 1 : argv[i]))
+                return 1;
+        }
+    }
+
+    if (pack_write(&list, argv[1]))
+        return 1;
+
+    printf("%lu ROMs packed into %s\n", list.count, argv[1]);
+    return 0;
+}
+
+/**
+ * @brief Read a ROM file into the list
+ *
+ * @param path the file to read
+ * @param name the name it is looked up by in the archive
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 pack_add(pack_list *list, const char *path, const char *name)
+{
+    if (list->count == list->size)
+    {
+        uint32 size = list->size ? list->size * 2 : 256;
+        pack_rom *grown = realloc(list->rom, size * sizeof(pack_rom));
+
+        if (grown == 0)
+        {
+            fprintf(stderr, "Error while packing ROMs: out of memory\n");
+            return 1;
+        }
+
+        list->rom = grown;
+        list->size = size;
+    }
+
+    FILE *file = fopen(path, "rb");
+
+    if (file == 0)
+    {
+        perror("Failed to load ROM.\n");
+        return 1;
+    }
+
+    pack_rom *rom = &list->rom[list->count];
+
+    // a ROM never exceeds the program space, anything past it is never loaded
+    rom->data = malloc(0x1000 - 0x200);
+    rom->name = strdup(name);
+
+    if (rom->data == 0 || rom->name == 0)
+    {
+        fprintf(stderr, "Error while packing ROMs: out of memory\n");
+        fclose(file);
+        return 1;
+    }
+
+    rom->size = fread(rom->data, 1, 0x1000 - 0x200, file);
+    rom->hash = util_chip_hash(rom->data, rom->size);
+    fclose(file);
+
+    list->count++;
+    return 0;
+}
+
+/**
+ * @brief Read every .ch8 file of a directory into the list
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 pack_add_dir(pack_list *list, const char *dir)
+{
+    DIR *handle = opendir(dir);
+
+    if (handle == 0)
+    {
+        perror("Failed to open ROM directory.\n");
+        return 1;
+    }
+
+    struct dirent *entry;
+
+    while ((entry = readdir(handle)))
+    {
+        size_t length = strlen(entry->d_name);
+
+        if (length < 4 || strcmp(entry->d_name + length - 4, ".ch8"))
+            continue;
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+
+        if (pack_add(list, path, entry->d_name))
+        {
+            closedir(handle);
+            return 1;
+        }
+    }
+
+    closedir(handle);
+    return 0;
+}
+
+static int pack_compare_hash(const void *a, const void *b)
+{
+    const pack_rom *x = a, *y = b;
+
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+
+    return strcmp(x->name, y->name);
+}
+
+static pack_rom *pack_sorted;
+
+static int pack_compare_name(const void *a, const void *b)
+{
+    return strcmp(pack_sorted[*(const uint32 *)a].name, pack_sorted[*(const uint32 *)b].name);
+}
+
+/**
+ * @brief Write the archive: header, hash index, name index, names, then data
+ *
+ * Identical ROMs share their bytes in the data section; names must be unique.
+ *
+ * @return 1 if error occurred, 0 otherwise
+ */
+uint8 pack_write(pack_list *list, const char *fileName)
+{
+    qsort(list->rom, list->count, sizeof(pack_rom), pack_compare_hash);
+
+    uint32 *by_name = malloc((list->count + 1) * sizeof(uint32));
+
+    if (by_name == 0)
+    {
+        fprintf(stderr, "Error while packing ROMs: out of memory\n");
+        return 1;
+    }
+
+    for (uint32 i = 0; i < list->count; i++)
+        by_name[i] = i;
+
+    pack_sorted = list->rom;
+    qsort(by_name, list->count, sizeof(uint32), pack_compare_name);
+
+    // a name must find one ROM, so two files of the same name from different directories are refused
+    for (uint32 i = 1; i < list->count; i++)
+        if (strcmp(list->rom[by_name[i - 1]].name, list->rom[by_name[i]].name) == 0)
+        {
+            fprintf(stderr, "Error while packing ROMs: more than one ROM named %s\n", list->rom[by_name[i]].name);
+            free(by_name);
+            return 1;
+        }
+
+    uint64 names = 0, data = 0;
+
+    for (uint32 i = 0; i < list->count; i++)
+    {
+        pack_rom *rom = &list->rom[i];
+        pack_rom *previous = i ? &list->rom[i - 1] : 0;
+
+        names += strlen(rom->name) + 1;
+
+        if (previous && previous->hash == rom->hash && previous->size == rom->size && memcmp(previous->data, rom->data, rom->size) == 0)
+        {
+            rom->offset = previous->offset;
+            rom->shared = 1;
+        }
+        else
+        {
+            rom->offset = data;
+            rom->shared = 0;
+            data += rom->size;
+        }
+    }
+
+    if (names > 0xFFFFFFFF || data > 0xFFFFFFFF)
+    {
+        fprintf(stderr, "Error while packing ROMs: archive larger than 4 GiB\n");
+        free(by_name);
+        return 1;
+    }
+
+    FILE *file = fopen(fileName, "wb");
+
+    if (file == 0)
+    {
+        perror("Failed to create ROM archive.\n");
+        free(by_name);
+        return 1;
+    }
+
+    uint64 index = CHIP_PACK_HEADER;
+    uint64 name_start = index + (uint64)list->count * (CHIP_PACK_ENTRY + 4);
+
+    uint8 header[CHIP_PACK_HEADER] = {0};
+    memcpy(header, CHIP_PACK_MAGIC, 4);
+    util_pack_write(header + 4, CHIP_PACK_VERSION, 4);
+    util_pack_write(header + 8, list->count, 4);
+    util_pack_write(header + 16, index, 8);
+    util_pack_write(header + 24, name_start, 8);
+    util_pack_write(header + 32, name_start + names, 8);
+    fwrite(header, sizeof(header), 1, file);
+
+    uint64 name = 0;
+
+    for (uint32 i = 0; i < list->count; i++)
+    {
+        pack_rom *rom = &list->rom[i];
+        uint8 entry[CHIP_PACK_ENTRY];
+        uint64 length = strlen(rom->name);
+
+        util_pack_write(entry, rom->hash, 8);
+        util_pack_write(entry + 8, rom->offset, 4);
+        util_pack_write(entry + 12, rom->size, 4);
+        util_pack_write(entry + 16, name, 4);
+        util_pack_write(entry + 20, length, 4);
+        fwrite(entry, sizeof(entry), 1, file);
+
+        name += length + 1;
+    }
+
+    for (uint32 i = 0; i < list->count; i++)
+    {
+        uint8 entry[4];
+        util_pack_write(entry, by_name[i], 4);
+        fwrite(entry, sizeof(entry), 1, file);
+    }
+
+    for (uint32 i = 0; i < list->count; i++)
+        fwrite(list->rom[i].name, strlen(list->rom[i].name) + 1, 1, file);
+
+    for (uint32 i = 0; i < list->count; i++)
+        if (!list->rom[i].shared)
+            fwrite(list->rom[i].data, list->rom[i].size, 1, file);
+
+    free(by_name);
+
+    if (ferror(file) | fclose(file))
+    {
+        perror("Failed to write ROM archive.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+void pack_usage()
+{
+    fprintf(stderr, "usage: chipEmu-pack ARCHIVE ROM|DIR ...\n");
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <chip/chip.h>
+#include <chip/chip_pack.h>
+#include <chip/chip_pool.h>
+#include <chip/chip_quirks.h>
+
+// how to detect, shared by every ROM
+typedef struct quirks_options
+{
+    uint32 frames;
+    uint8 verbose;
+    chip_pool *pool;
+    chip_quirk_cache *cache;
+} quirks_options;
+
+void quirks_rom(const quirks_options *, const char *, const uint8 *, uint32);
+void quirks_usage();
+
+int main(int argc, char **argv)
+{
+    quirks_options options = {.frames = CHIP_QUIRKS_FRAMES};
+    uint32 threads = 0;
+    const char *cache = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:f:c:vh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'j':
+            threads = strtoul(optarg, 0, 10);
+            break;
+        case 'f':
+            options.frames = strtoul(optarg, 0, 10);
+            break;
+        case 'c':
+            cache = optarg;
+            break;
+        case 'v':
+            options.verbose = 1;
+            break;
+        default:
+            quirks_usage();
+            return 1;
+        }
+    }
+
+    if (optind == argc)
+    {
+        quirks_usage();
+        return 1;
+    }
+
+    // the profiles of a ROM run side by side, one ROM after the other
+    if ((options.pool = util_pool_create(threads, 0)) == 0)
+        return 1;
+
+    if (cache && (options.cache = util_quirk_cache_open(cache)) == 0)
+        return 1;
+
+    printf("rom\tquirks\tprofile\n");
+
+    for (int i = optind; i < argc; i++)
+    {
+        size_t length = strlen(argv[i]);
+
+        if (length > 5 && strcmp(argv[i] + length - 5, ".c8pk") == 0)
+        {
+            chip_pack *pack = util_pack_open(argv[i]);
+
+            if (pack == 0)
+                return 1;
+
+            for (uint32 e = 0; e < pack->count; e++)
+            {
+                chip_rom rom;
+                char path[4096];
+
+                util_pack_entry(pack, util_pack_read(pack->by_name + (uint64)e * 4, 4), &rom);
+                snprintf(path, sizeof(path), "%s:%s", argv[i], rom.name);
+
+                quirks_rom(&options, path, rom.data, rom.size);
+            }
+
+            util_pack_close(pack);
+            continue;
+        }
+
+        uint8 rom[0x1000 - 0x200];
+        uint32 size;
+
+        if (util_chip_read_ROM(argv[i], rom, &size))
+            return 1;
+
+        quirks_rom(&options, argv[i], rom, size);
+    }
+
+    util_pool_destroy(options.pool);
+
+    return options.cache ? util_quirk_cache_close(options.cache) : 0;
+}
+
+/**
+ * @brief Detect the quirks of one ROM, or find them in the cache, and print them
+ *
+ * @param path the name the ROM is printed with
+ */
+void quirks_rom(const quirks_options *options, const char *path, const uint8 *rom, uint32 size)
+{
+    uint64 hash = util_chip_hash(rom, size);
+    uint8 quirks;
+
+    if (options->cache && !options->verbose && util_quirk_cache_get(options->cache, hash, &quirks))
+    {
+        const char *name = util_quirks_name(quirks);
+        printf("%s\t%02x\t%s\n", path, quirks, name ? name : "-");
+        return;
+    }
+
+    chip_quirk_trial trial[CHIP_QUIRKS + 1];
+    quirks = util_quirks_detect(rom, size, options->frames, options->pool, trial);
+
+    if (options->cache)
+        util_quirk_cache_put(options->cache, hash, quirks);
+
+    const char *name = util_quirks_name(quirks);
+    printf("%s\t%02x\t%s\n", path, quirks, name ? name : "-");
+
+    if (options->verbose)
+        for (uint32 q = 0; q <= CHIP_QUIRKS; q++)
+            printf("\t%02x\tpenalty %llu\tscreens %lu\n", trial[q].quirks, trial[q].penalty, trial[q].screens);
+}
+
+void quirks_usage()
+{
+    fprintf(stderr, "usage: chipEmu-quirks [-j threads] [-f frames] [-c quirks.cache] [-v] ROM|ARCHIVE ...\n");
+}
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <chip/chip.h>
+#include <chip/chip_translate.h>
+
+void translate_usage();
+
+int main(int argc, char **argv)
+{
+    const char *name = "chip_aot";
+    const char *output = 0;
+    uint8 standalone = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:o:mh")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            name = optarg;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'm':
+            standalone = 1;
+            break;
+        default:
+            translate_usage();
+            return 1;
+        }
+    }
+
+    if (optind != argc - 1)
+    {
+        translate_usage();
+        return 1;
+    }
+
+    static uint8 bytes[0x1000 - 0x200];
+    static chip_translation translation;
+    uint32 size;
+
+    if (util_chip_read_ROM(argv[optind], bytes, &size))
+        return 1;
+
+    util_analysis_walk(&translation.rom, bytes, size);
+
+    FILE *file = output ? fopen(output, "w") : stdout;
+
+    if (file == 0)
+    {
+        perror("Failed to create translation.\n");
+        return 1;
+    }
+
+    if (util_translate_write(file, &translation, argv[optind], name, standalone))
+        return 1;
+
+    if (output && fclose(file))
+    {
+        perror("Failed to write translation.\n");
+        return 1;
+    }
+
+    fprintf(stderr, "%lu blocks, %lu instructions translated, %lu dead flags skipped\n", translation.rom.blocks, translation.rom.instructions, translation.flags);
+    return 0;
+}
+
+void translate_usage()
+{
+    fprintf(stderr, "usage: chipEmu-translate [-n name] [-m] [-o out.c] ROM\n");
+}